@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "arena.h"
+
+void arenaInit(Arena* arena, size_t reserve){
+    // only address space is taken here, pages are made usable by arenaAlloc
+    arena->reserved = (reserve+ARENA_COMMIT-1)/ARENA_COMMIT*ARENA_COMMIT;
+    arena->used = 0;
+    arena->committed = 0;
+    void* base = mmap(NULL, arena->reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(base == MAP_FAILED){
+        printf("Error: cannot reserve %zu bytes for an arena\n", arena->reserved);
+        exit(-1);
+    }
+    arena->base = base;
+}
+
+void* arenaAlloc(Arena* arena, size_t size, size_t align){
+    // align is a power of 2
+    size_t start = (arena->used+align-1) & ~(align-1);
+    if(start+size > arena->reserved){
+        printf("Error: arena of %zu bytes is full\n", arena->reserved);
+        exit(-1);
+    }
+    if(start+size > arena->committed){
+        size_t end = min((start+size+ARENA_COMMIT-1)/ARENA_COMMIT*ARENA_COMMIT, arena->reserved);
+        if(mprotect(arena->base+arena->committed, end-arena->committed, PROT_READ | PROT_WRITE) != 0){
+            printf("Error: out of memory for an arena of %zu bytes\n", end);
+            exit(-1);
+        }
+        arena->committed = end;
+    }
+    arena->used = start+size;
+    return arena->base+start;
+}
+
+void arenaReset(Arena* arena){
+    // committed pages are kept for the next use
+    arena->used = 0;
+}
+
+void arenaFree(Arena* arena){
+    munmap(arena->base, arena->reserved);
+    arena->base = NULL;
+    arena->used = arena->committed = arena->reserved = 0;
+}
+
+static void nodeLayout(NodeStore* store, const Board* board, uint32_t maxNodes){
+    // a 20 tube board of capacity 4 and at most 15 colors takes 52 bytes a node
+    store->size = boardSize(board);
+    store->nibbles = board->colorNum < 16;
+    store->packedSize = store->nibbles ? (store->size+1)/2 : store->size;
+    store->stride = (sizeof(SearchNode)+store->packedSize+3) & ~3;
+    store->num = 0;
+    store->cap = min(maxNodes, NODE_NONE);
+}
+
+void nodeStoreInit(NodeStore* store, const Board* board, uint32_t maxNodes){
+    nodeLayout(store, board, maxNodes);
+    arenaInit(&store->arena, (size_t)store->cap*store->stride);
+}
+
+SearchNode* nodeAt(const NodeStore* store, uint32_t idx){
+    return (SearchNode*)(store->arena.base+(size_t)idx*store->stride);
+}
+
+uint32_t nodeAdd(NodeStore* store, const unsigned char* state, uint32_t parent, Move move, int depth){
+    // returns the index of the new node
+    if(store->num == store->cap){
+        printf("Error: node store is full at %u nodes\n", store->cap);
+        exit(-1);
+    }
+    SearchNode* node = arenaAlloc(&store->arena, store->stride, 4);
+    node->parent = parent;
+    node->from = move.from;
+    node->to = move.to;
+    node->count = move.count;
+    node->depth = depth;
+    if(!store->nibbles) memcpy(node->board, state, store->size);
+    else {
+        for(int i = 0; i+1 < store->size; i += 2) node->board[i/2] = state[i] | state[i+1] << 4;
+        if(store->size & 1) node->board[store->size/2] = state[store->size-1];
+    }
+    return store->num++;
+}
+
+void nodeBoard(const NodeStore* store, uint32_t idx, unsigned char* state){
+    // unpacks the board of a node into state, boardSize bytes
+    const SearchNode* node = nodeAt(store, idx);
+    if(!store->nibbles){
+        memcpy(state, node->board, store->size);
+        return;
+    }
+    for(int i = 0; i+1 < store->size; i += 2){
+        state[i] = node->board[i/2] & 15;
+        state[i+1] = node->board[i/2] >> 4;
+    }
+    if(store->size & 1) state[store->size-1] = node->board[store->size/2];
+}
+
+int nodePath(const NodeStore* store, uint32_t idx, Move* moves){
+    // pours from the root to the node into moves (depth of the node entries), returns their #
+    int depth = nodeAt(store, idx)->depth;
+    for(int d = depth-1; d >= 0; d--){
+        const SearchNode* node = nodeAt(store, idx);
+        moves[d] = (Move){ node->from, node->to, node->count };
+        idx = node->parent;
+    }
+    return depth;
+}
+
+void nodeStoreReset(NodeStore* store, const Board* board, uint32_t maxNodes){
+    // drops every node at once for a search of board. the committed memory is reused,
+    // the range is only mapped again if the new board needs more
+    nodeLayout(store, board, maxNodes);
+    if((size_t)store->cap*store->stride <= store->arena.reserved) arenaReset(&store->arena);
+    else {
+        arenaFree(&store->arena);
+        arenaInit(&store->arena, (size_t)store->cap*store->stride);
+    }
+}
+
+void nodeStoreFree(NodeStore* store){
+    arenaFree(&store->arena);
+    store->num = 0;
+}
@@ -0,0 +1,55 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "board.h"
+
+#define ARENA_COMMIT        (1 << 22)   // bytes made usable at a time, 4 MB
+#define NODE_NONE           UINT32_MAX  // parent of a root node
+
+// bump allocator over one reserved address range: memory is committed as it is
+// used, nothing is freed one by one and a reset frees everything at once
+typedef struct Arena {
+    unsigned char* base;
+    size_t used;
+    size_t committed;
+    size_t reserved;
+} Arena;
+
+// search node: the pour that reached the board from its parent, then the board
+typedef struct SearchNode {
+    uint32_t parent;    // node index, NODE_NONE for a root
+    uint16_t from;
+    uint16_t to;
+    uint16_t count;
+    uint16_t depth;     // # of pours from the root
+    unsigned char board[];
+} SearchNode;
+
+// nodes of one search stored back to back in an arena and named by a 32 bit index.
+// boards of at most 15 colors take a nibble per water unit, larger ones a byte
+typedef struct NodeStore {
+    Arena arena;
+    int size;           // bytes of an unpacked board
+    int packedSize;
+    int stride;         // bytes per node
+    bool nibbles;
+    uint32_t num;
+    uint32_t cap;
+} NodeStore;
+
+void arenaInit(Arena* arena, size_t reserve);
+void* arenaAlloc(Arena* arena, size_t size, size_t align);
+void arenaReset(Arena* arena);
+void arenaFree(Arena* arena);
+
+void nodeStoreInit(NodeStore* store, const Board* board, uint32_t maxNodes);
+SearchNode* nodeAt(const NodeStore* store, uint32_t idx);
+uint32_t nodeAdd(NodeStore* store, const unsigned char* state, uint32_t parent, Move move, int depth);
+void nodeBoard(const NodeStore* store, uint32_t idx, unsigned char* state);
+int nodePath(const NodeStore* store, uint32_t idx, Move* moves);
+void nodeStoreReset(NodeStore* store, const Board* board, uint32_t maxNodes);
+void nodeStoreFree(NodeStore* store);
+
+#endif // ARENA_H
@@ -0,0 +1,16 @@
+#include <string.h>
+#include "asset.h"
+#include "trace.h"
+
+Texture2D loadAssetTexture(const char* name, const char* path){
+    // embedded pixels go straight to the GPU, the file at path is only decoded
+    // when the asset was not embedded
+    TRACE_BEGIN("loadAsset");
+    Texture2D texture = { 0 };
+    for(int i = 0; i < ASSET_NUM && !texture.id; i++)
+        if(strcmp(ASSETS[i].name, name) == 0)
+            texture = LoadTextureFromImage((Image){ (void*)ASSETS[i].pixels, ASSETS[i].width, ASSETS[i].height, 1, ASSETS[i].format });
+    if(!texture.id) texture = LoadTexture(path);
+    TRACE_END("loadAsset");
+    return texture;
+}
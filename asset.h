@@ -0,0 +1,20 @@
+#ifndef ASSET_H
+#define ASSET_H
+
+#include "raylib.h"
+
+// image decoded at build time by embed, pixels in a format textures take as is
+typedef struct Asset {
+    const char* name;       // file name without directory and extension
+    int width;
+    int height;
+    int format;             // PixelFormat
+    const unsigned char* pixels;
+} Asset;
+
+extern const Asset ASSETS[];
+extern const int ASSET_NUM;
+
+Texture2D loadAssetTexture(const char* name, const char* path);
+
+#endif // ASSET_H
@@ -0,0 +1,304 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "raylib.h"
+#include "utils.h"
+#include "solver.h"
+#include "cache.h"
+#include "simd.h"
+#include "visited.h"
+
+#define BENCH_LEVEL_NUM     60
+#define BENCH_STATE_NUM     20000   // states sampled per level for branching factors
+#define BENCH_VISITED_NUM   ((size_t)(VISITED_MAX_LOAD*VISITED_BUCKET_SIZE*(1 << 22))) // a visited set at full load
+
+typedef struct PruneCase {
+    const char* name;
+    int rules;
+} PruneCase;
+
+static const PruneCase pruneCases[] = {
+    { "none",    PRUNE_NONE },
+    { "empty",   PRUNE_EMPTY },
+    { "reverse", PRUNE_REVERSE },
+    { "split",   PRUNE_SPLIT },
+    { "commute", PRUNE_COMMUTE },
+    { "safe",    PRUNE_SAFE },
+    { "all",     PRUNE_ALL },
+};
+#define PRUNE_CASE_NUM ((int)(sizeof(pruneCases)/sizeof(pruneCases[0])))
+
+volatile long long benchSink; // keeps timed calls from being optimized out
+
+double benchTime(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec+ts.tv_nsec*1e-9;
+}
+
+unsigned char* benchLevel(Board* board, int idx){
+    // level corpus: the built-in level followed by shuffled levels of growing size
+    if(idx == 0){
+        Tubes* tubes = newTubes(TUBE_NUM);
+        initTubes(tubes);
+        unsigned char* state = boardFromTubes(board, tubes);
+        freeTubes(tubes);
+        return state;
+    }
+    return boardRandom(board, 3+idx%10, 2, TUBE_CAPACITY, idx);
+}
+
+int pairwiseMoves(const Board* board, const unsigned char* state, Move* moves){
+    // baseline: boardPourCount on every (from, to) pair, like checkPour per click
+    int moveNum = 0;
+    for(int from = 0; from < board->tubeNum; from++)
+        for(int to = 0; to < board->tubeNum; to++){
+            int pourCnt = boardPourCount(board, state, from, to);
+            if(pourCnt > 0) moves[moveNum++] = (Move){ from, to, pourCnt };
+        }
+    return moveNum;
+}
+
+int moveCompare(const void* a, const void* b){
+    const Move* x = a;
+    const Move* y = b;
+    if(x->from != y->from) return x->from-y->from;
+    return x->to-y->to;
+}
+
+void benchMoveGen(void){
+    // shuffled boards of growing size with 4 empty tubes
+    int sizes[] = { 8, 20, 50, 100, 200, 250 };
+    printf("Move generation, pairwise boardPourCount vs boardMoves:\n");
+    for(int k = 0; k < (int)(sizeof(sizes)/sizeof(sizes[0])); k++){
+        Board board;
+        unsigned char* state = boardRandom(&board, sizes[k]-4, 4, TUBE_CAPACITY, k+1);
+        Move* moves = malloc(sizeof(Move)*board.tubeNum*board.tubeNum);
+        Move* expected = malloc(sizeof(Move)*board.tubeNum*board.tubeNum);
+        int moveNum = boardMoves(&board, state, moves);
+        int expectedNum = pairwiseMoves(&board, state, expected);
+        qsort(moves, moveNum, sizeof(Move), moveCompare);
+        qsort(expected, expectedNum, sizeof(Move), moveCompare);
+        if(moveNum != expectedNum || memcmp(moves, expected, sizeof(Move)*moveNum) != 0){
+            printf("Error: move generators disagree on %d tubes\n", board.tubeNum);
+            exit(-1);
+        }
+
+        int iterations = max(20000000/(board.tubeNum*board.tubeNum), 10);
+        double begin = benchTime();
+        for(int i = 0; i < iterations; i++) benchSink += pairwiseMoves(&board, state, expected);
+        double pairwise = (benchTime()-begin)/iterations;
+        begin = benchTime();
+        for(int i = 0; i < iterations; i++) benchSink += boardMoves(&board, state, moves);
+        double bitboard = (benchTime()-begin)/iterations;
+        printf("  %4d tubes, %4d pours: %9.2f us vs %7.2f us (%5.1fx)\n", board.tubeNum, moveNum,
+               pairwise*1e6, bitboard*1e6, pairwise/bitboard);
+        free(expected);
+        free(moves);
+        free(state);
+    }
+}
+
+void benchKernels(void){
+    // solved boards are the worst case, every byte has to be looked at
+    int sizes[] = { 8, 20, 50, 100, 250 };
+    printf("Board kernels (%s), scalar vs vectorized:\n", simdName());
+    for(int k = 0; k < (int)(sizeof(sizes)/sizeof(sizes[0])); k++){
+        Board board;
+        unsigned char* state = boardRandom(&board, sizes[k]-2, 2, TUBE_CAPACITY, k+1);
+        int size = boardSize(&board);
+        unsigned char* solved = malloc(size);
+        unsigned char* copy = malloc(size);
+        for(int i = 0; i < size; i++) solved[i] = i/board.capacity < board.colorNum ? 1+i/board.capacity : BOARD_EMPTY;
+        memcpy(copy, solved, size);
+        uint64_t mask[4], expected[4];
+        for(int i = 0; i < size; i++){
+            // flip each byte in turn and check every kernel against its scalar version
+            unsigned char* boards[] = { state, solved };
+            for(int b = 0; b < 2; b++){
+                unsigned char* s = boards[b];
+                s[i] ^= 1;
+                stateUniform(s, size, board.capacity, mask);
+                stateUniformScalar(s, size, board.capacity, expected);
+                if(stateSolved(s, size, board.capacity) != stateSolvedScalar(s, size, board.capacity) ||
+                   stateEqual(s, copy, size) != stateEqualScalar(s, copy, size) ||
+                   memcmp(mask, expected, sizeof(uint64_t)*((board.tubeNum+63)/64)) != 0){
+                    printf("Error: board kernels disagree on %d tubes\n", board.tubeNum);
+                    exit(-1);
+                }
+                s[i] ^= 1;
+            }
+        }
+
+        int iterations = max(200000000/size, 10);
+        double begin = benchTime();
+        for(int i = 0; i < iterations; i++) benchSink += stateSolvedScalar(solved, size, board.capacity);
+        double scalarSolved = (benchTime()-begin)/iterations;
+        begin = benchTime();
+        for(int i = 0; i < iterations; i++) benchSink += stateSolved(solved, size, board.capacity);
+        double simdSolved = (benchTime()-begin)/iterations;
+        begin = benchTime();
+        for(int i = 0; i < iterations; i++) benchSink += stateEqualScalar(solved, copy, size);
+        double scalarEqual = (benchTime()-begin)/iterations;
+        begin = benchTime();
+        for(int i = 0; i < iterations; i++) benchSink += stateEqual(solved, copy, size);
+        double simdEqual = (benchTime()-begin)/iterations;
+        printf("  %4d tubes: solved %7.1f ns vs %6.1f ns (%4.1fx), equal %7.1f ns vs %6.1f ns (%4.1fx)\n",
+               board.tubeNum, scalarSolved*1e9, simdSolved*1e9, scalarSolved/simdSolved,
+               scalarEqual*1e9, simdEqual*1e9, scalarEqual/simdEqual);
+        free(copy);
+        free(solved);
+        free(state);
+    }
+}
+
+void benchBranching(int levelNum){
+    // breadth-first sample of each level with all legal pours, counting how many
+    // pours each rule set leaves at every sampled board
+    double total[PRUNE_CASE_NUM] = { 0 };
+    long long sampled = 0;
+    for(int l = 0; l < levelNum; l++){
+        Board board;
+        unsigned char* start = benchLevel(&board, l);
+        int size = boardSize(&board);
+        unsigned char* queue = malloc((size_t)BENCH_STATE_NUM*size);
+        Move* lastMoves = malloc(sizeof(Move)*BENCH_STATE_NUM);
+        Move* moves = malloc(sizeof(Move)*board.tubeNum*board.tubeNum);
+        uint64_t* seen = calloc(BENCH_STATE_NUM*4, sizeof(uint64_t));
+        int head = 0, tail = 1;
+        memcpy(queue, start, size);
+        lastMoves[0] = NO_MOVE;
+        seen[boardHash(&board, start) % (BENCH_STATE_NUM*4)] = boardHash(&board, start);
+        while(head < tail){
+            unsigned char* state = queue+(size_t)head*size;
+            for(int c = 0; c < PRUNE_CASE_NUM; c++)
+                total[c] += boardPrunedMoves(&board, state, lastMoves[head], pruneCases[c].rules, moves);
+            sampled++;
+            int moveNum = boardMoves(&board, state, moves);
+            for(int m = 0; m < moveNum && tail < BENCH_STATE_NUM; m++){
+                unsigned char* child = queue+(size_t)tail*size;
+                memcpy(child, state, size);
+                boardPour(&board, child, moves[m].from, moves[m].to);
+                uint64_t hash = boardHash(&board, child);
+                size_t slot = hash % (BENCH_STATE_NUM*4);
+                while(seen[slot] && seen[slot] != hash) slot = (slot+1) % (BENCH_STATE_NUM*4);
+                if(seen[slot]) continue;
+                seen[slot] = hash;
+                lastMoves[tail++] = moves[m];
+            }
+            head++;
+        }
+        free(seen);
+        free(moves);
+        free(lastMoves);
+        free(queue);
+        free(start);
+    }
+    printf("Branching factor over %lld boards of %d levels:\n", sampled, levelNum);
+    for(int c = 0; c < PRUNE_CASE_NUM; c++)
+        printf("  %-8s %6.2f pours/board (%5.1f%% of legal)\n", pruneCases[c].name,
+               total[c]/sampled, 100.0*total[c]/total[0]);
+}
+
+void benchBeam(int levelNum){
+    // solutions go to the solution cache, the last pass reads them back
+    printf("Beam search (width %d) over %d levels:\n", BEAM_WIDTH, levelNum);
+    SolutionCache* cache = cacheOpen(CACHE_FILE);
+    int rules[] = { PRUNE_NONE, PRUNE_SAFE, PRUNE_ALL };
+    const char* names[] = { "none", "safe", "all" };
+    for(int r = 0; r < 3; r++){
+        SOLVER_PRUNE = rules[r];
+        int solved = 0;
+        long long moves = 0, expanded = 0;
+        double begin = benchTime();
+        for(int l = 0; l < levelNum; l++){
+            Board board;
+            unsigned char* start = benchLevel(&board, l);
+            Solution solution = beamSearch(&board, start, BEAM_WIDTH, BEAM_MAX_DEPTH, 0);
+            cacheStoreSolution(cache, &board, start, &solution);
+            if(solution.solved){
+                solved++;
+                moves += solution.moveNum;
+            }
+            expanded += solution.expanded;
+            freeSolution(&solution);
+            free(start);
+        }
+        printf("  %-8s solved %d/%d, %.1f pours/solution, %lld expanded, %.3f s\n", names[r],
+               solved, levelNum, solved ? 1.0*moves/solved : 0.0, expanded, benchTime()-begin);
+    }
+    SOLVER_PRUNE = PRUNE_ALL;
+
+    // wait for the writer so every stored solution can be found
+    cacheClose(cache);
+    cache = cacheOpen(CACHE_FILE);
+    int solved = 0;
+    long long moves = 0, expanded = 0;
+    double begin = benchTime();
+    for(int l = 0; l < levelNum; l++){
+        Board board;
+        unsigned char* start = benchLevel(&board, l);
+        Solution solution = cachedSearch(cache, &board, start, BEAM_WIDTH, BEAM_MAX_DEPTH, 0);
+        if(solution.solved){
+            solved++;
+            moves += solution.moveNum;
+        }
+        expanded += solution.expanded;
+        freeSolution(&solution);
+        free(start);
+    }
+    printf("  %-8s solved %d/%d, %.1f pours/solution, %lld expanded, %.3f s%s\n", "cached",
+           solved, levelNum, solved ? 1.0*moves/solved : 0.0, expanded, benchTime()-begin,
+           cache ? "" : " (no cache file)");
+    cacheClose(cache);
+}
+
+void benchVisited(size_t stateNum){
+    // random hashes stand for canonical board hashes: stateNum are inserted, then
+    // looked up again and as many never inserted ones are looked up. a second set
+    // in verify mode counts the inserts taken for visited boards
+    VisitedSet set;
+    visitedInit(&set, stateNum, false);
+    uint64_t rng = 1;
+    double begin = benchTime();
+    for(size_t i = 0; i < stateNum; i++) visitedInsert(&set, nextRandom(&rng));
+    double insert = (benchTime()-begin)/stateNum;
+    long long missing = 0, falsePositives = 0;
+    rng = 1;
+    for(size_t i = 0; i < stateNum; i++) missing += !visitedContains(&set, nextRandom(&rng));
+    begin = benchTime();
+    for(size_t i = 0; i < stateNum; i++) falsePositives += visitedContains(&set, nextRandom(&rng));
+    double lookup = (benchTime()-begin)/stateNum;
+    if(missing > 0){
+        printf("Error: visited set lost %lld boards\n", missing);
+        exit(-1);
+    }
+    double perState = (double)set.bytes/stateNum;
+    printf("Visited set, %zu boards at load %.2f (%s pages):\n", stateNum, visitedLoad(&set),
+           set.hugePages ? "huge" : "small");
+    printf("  %.2f bytes/board, %.1f GB for a billion boards, %zu in the overflow\n", perState, perState*1e9/(1 << 30),
+           set.overflowNum);
+    printf("  insert %.1f ns, lookup %.1f ns\n", insert*1e9, lookup*1e9);
+    visitedFree(&set);
+
+    visitedInit(&set, stateNum, true);
+    rng = 1;
+    for(size_t i = 0; i < stateNum; i++) visitedInsert(&set, nextRandom(&rng));
+    printf("  false positives: %lld/%lld inserts, %lld/%zu lookups, %.1e expected each\n", set.falsePositives,
+           set.lookups, falsePositives, stateNum, visitedExpectedRate(&set));
+    visitedFree(&set);
+}
+
+int main(int argc, char** argv){
+    //   ./bench [level count] [visited boards]
+    int levelNum = argc > 1 ? atoi(argv[1]) : BENCH_LEVEL_NUM;
+    size_t visitedNum = argc > 2 ? strtoull(argv[2], NULL, 10) : BENCH_VISITED_NUM;
+    benchMoveGen();
+    benchKernels();
+    benchBranching(levelNum);
+    benchBeam(levelNum);
+    benchVisited(visitedNum);
+    return 0;
+}
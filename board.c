@@ -0,0 +1,354 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "board.h"
+#include "simd.h"
+#include "layout.h"
+#include "perfcount.h"
+
+int boardSize(const Board* board){
+    return board->tubeNum*board->capacity;
+}
+
+unsigned char* boardFromTubes(Board* board, const Tubes* tubes){
+    // pack the contents of still tubes, colors are numbered by first appearance
+    board->tubeNum = TUBE_NUM;
+    board->capacity = TUBE_CAPACITY;
+    board->colorNum = 0;
+    board->palette[BOARD_EMPTY] = BLANK;
+    unsigned char* state = malloc(boardSize(board));
+    for(int i = 0; i < TUBE_NUM; i++){
+        for(int j = 0; j < TUBE_CAPACITY; j++){
+            Color col = tubes->contains[i][j];
+            int id = BOARD_EMPTY;
+            if(!emptyColor(col)){
+                for(id = 1; id <= board->colorNum; id++)
+                    if(sameColor(board->palette[id], col)) break;
+                if(id > board->colorNum){
+                    if(board->colorNum == BOARD_MAX_COLOR){
+                        printf("Error: too many colors to pack the board\n");
+                        exit(-1);
+                    }
+                    board->palette[++board->colorNum] = col;
+                }
+            }
+            state[i*board->capacity+j] = id;
+        }
+    }
+    return state;
+}
+
+void boardToTubes(const Board* board, const unsigned char* state, Tubes* tubes){
+    for(int i = 0; i < board->tubeNum; i++)
+        for(int j = 0; j < board->capacity; j++)
+            tubes->contains[i][j] = board->palette[state[i*board->capacity+j]];
+}
+
+Tubes* boardNewTubes(const Board* board, const unsigned char* state){
+    // still tubes laid out for the window holding the board, the tube capacity is switched to the board's
+    setTubeCapacity(board->capacity);
+    Tubes* tubes = newTubes(board->tubeNum);
+    for(int i = 0; i < TUBE_NUM; i++)
+        initTube(tubes, i, layoutTube(i), 0.0, (Color[MAX_TUBE_WATER]){ 0 });
+    boardToTubes(board, state, tubes);
+    return tubes;
+}
+
+int tubeLevel(const unsigned char* tube, int capacity){
+    int level = 0;
+    while(level < capacity && tube[level] != BOARD_EMPTY) level++;
+    return level;
+}
+
+int tubeTopRun(const unsigned char* tube, int level){
+    // length of the same-color run on top of the tube
+    if(level == 0) return 0;
+    int run = 1;
+    while(run < level && tube[level-run-1] == tube[level-1]) run++;
+    return run;
+}
+
+bool boardCanPour(const Board* board, const unsigned char* state, int from, int to){
+    // same rules as checkPour for still tubes
+    if(from == to) return false;
+    const unsigned char* src = state+from*board->capacity;
+    const unsigned char* dst = state+to*board->capacity;
+    int c1 = tubeLevel(src, board->capacity), c2 = tubeLevel(dst, board->capacity);
+    if(c1 == 0 || c2 == board->capacity) return false;
+    return c2 == 0 || src[c1-1] == dst[c2-1];
+}
+
+int boardPourCount(const Board* board, const unsigned char* state, int from, int to){
+    // same count as pour: the whole top run, limited by the free space of the target
+    if(!boardCanPour(board, state, from, to)) return 0;
+    const unsigned char* src = state+from*board->capacity;
+    int c1 = tubeLevel(src, board->capacity);
+    int c2 = tubeLevel(state+to*board->capacity, board->capacity);
+    return min(tubeTopRun(src, c1), board->capacity-c2);
+}
+
+int boardPour(const Board* board, unsigned char* state, int from, int to){
+    PERF_BEGIN(PERF_POUR);
+    int pourCnt = boardPourCount(board, state, from, to);
+    unsigned char* src = state+from*board->capacity;
+    unsigned char* dst = state+to*board->capacity;
+    int c1 = tubeLevel(src, board->capacity), c2 = tubeLevel(dst, board->capacity);
+    for(int j = 0; j < pourCnt; j++){
+        dst[c2+j] = src[c1-j-1];
+        src[c1-j-1] = BOARD_EMPTY;
+    }
+    PERF_END(PERF_POUR);
+    return pourCnt;
+}
+
+void boardUnpour(const Board* board, unsigned char* state, Move move){
+    PERF_BEGIN(PERF_POUR);
+    unsigned char* src = state+move.from*board->capacity;
+    unsigned char* dst = state+move.to*board->capacity;
+    int c1 = tubeLevel(src, board->capacity), c2 = tubeLevel(dst, board->capacity);
+    for(int j = 0; j < move.count; j++){
+        src[c1+j] = dst[c2-j-1];
+        dst[c2-j-1] = BOARD_EMPTY;
+    }
+    PERF_END(PERF_POUR);
+}
+
+int boardMoves(const Board* board, const unsigned char* state, Move* moves){
+    // all legal pours in one pass over the board, grouped by the top color of the source:
+    // the targets of color c are (tubes topped with c & tubes with space) | empty tubes.
+    // `moves` must hold tubeNum*(tubeNum-1) entries
+    PERF_BEGIN(PERF_MOVES);
+    int n = board->tubeNum, cap = board->capacity, words = (n+63)/64;
+    unsigned char level[n], run[n];
+    int colorStart[board->colorNum+2], order[n];
+    uint64_t empty[words], hasSpace[words], colorMask[words], targets[words];
+    memset(colorStart, 0, sizeof(colorStart));
+    memset(empty, 0, sizeof(empty));
+    memset(hasSpace, 0, sizeof(hasSpace));
+    memset(colorMask, 0, sizeof(colorMask));
+    for(int i = 0; i < n; i++){
+        const unsigned char* tube = state+i*cap;
+        level[i] = tubeLevel(tube, cap);
+        if(level[i] == 0) empty[i >> 6] |= 1ULL << (i & 63);
+        else {
+            run[i] = tubeTopRun(tube, level[i]);
+            colorStart[tube[level[i]-1]+1]++;
+        }
+        if(level[i] < cap) hasSpace[i >> 6] |= 1ULL << (i & 63);
+    }
+    // bucket the non-empty tubes by top color
+    for(int c = 1; c <= board->colorNum+1; c++) colorStart[c] += colorStart[c-1];
+    int fill[board->colorNum+1];
+    memcpy(fill, colorStart, sizeof(fill));
+    for(int i = 0; i < n; i++)
+        if(level[i] > 0) order[fill[state[i*cap+level[i]-1]]++] = i;
+
+    int moveNum = 0;
+    for(int c = 1; c <= board->colorNum; c++){
+        int first = colorStart[c], last = colorStart[c+1];
+        if(first == last) continue;
+        for(int k = first; k < last; k++) colorMask[order[k] >> 6] |= 1ULL << (order[k] & 63);
+        for(int w = 0; w < words; w++) targets[w] = (colorMask[w] & hasSpace[w]) | empty[w];
+        for(int k = first; k < last; k++){
+            int from = order[k];
+            for(int w = 0; w < words; w++){
+                uint64_t bits = targets[w];
+                if(w == from >> 6) bits &= ~(1ULL << (from & 63));
+                while(bits){
+                    int to = (w << 6)+__builtin_ctzll(bits);
+                    bits &= bits-1;
+                    moves[moveNum++] = (Move){ from, to, min(run[from], cap-level[to]) };
+                }
+            }
+        }
+        for(int k = first; k < last; k++) colorMask[order[k] >> 6] = 0;
+    }
+    PERF_END(PERF_MOVES);
+    return moveNum;
+}
+
+static bool pruned(const Board* board, const unsigned char* state, Move move, Move last, int rules, int firstEmpty){
+    const unsigned char* src = state+move.from*board->capacity;
+    const unsigned char* dst = state+move.to*board->capacity;
+    int c1 = tubeLevel(src, board->capacity), c2 = tubeLevel(dst, board->capacity);
+    if(rules & PRUNE_EMPTY && c2 == 0){
+        // all empty tubes are alike, and a uniform tube moved to one gives the same board
+        if(move.to != firstEmpty || tubeTopRun(src, c1) == c1) return true;
+    }
+    if(rules & PRUNE_REVERSE && move.from == last.to && move.to == last.from){
+        // the two pours together never do more than a single pour from the board before them
+        return true;
+    }
+    if(rules & PRUNE_SPLIT && tubeTopRun(src, c1) > board->capacity-c2){
+        // the target ends up full, keep it only if it ends up a finished tube
+        if(c2 == 0 || tubeTopRun(dst, c2) != c2) return true;
+    }
+    if(rules & PRUNE_COMMUTE && last.from >= 0 && c2 > 0 &&
+       move.from != last.from && move.from != last.to && move.to != last.from && move.to != last.to){
+        // pours on disjoint tubes commute, only the increasing order is explored;
+        // pours into empty tubes are left out since PRUNE_EMPTY depends on which tube is empty
+        const unsigned char* lastDst = state+last.to*board->capacity;
+        bool lastToEmpty = tubeLevel(lastDst, board->capacity) == last.count;
+        if(!lastToEmpty && (move.from < last.from || (move.from == last.from && move.to < last.to))) return true;
+    }
+    return false;
+}
+
+bool movePruned(const Board* board, const unsigned char* state, Move move, Move last, int rules){
+    // true if `move` is legal but can be skipped by a search without losing solutions
+    // (PRUNE_SPLIT is the exception, it trades completeness for a smaller tree)
+    int firstEmpty = 0;
+    while(firstEmpty < board->tubeNum && state[firstEmpty*board->capacity] != BOARD_EMPTY) firstEmpty++;
+    return pruned(board, state, move, last, rules, firstEmpty);
+}
+
+int boardPrunedMoves(const Board* board, const unsigned char* state, Move last, int rules, Move* moves){
+    // legal pours from boardMoves without the ones movePruned rejects
+    int moveNum = boardMoves(board, state, moves), kept = 0;
+    if(rules == PRUNE_NONE) return moveNum;
+    PERF_BEGIN(PERF_PRUNE);
+    int firstEmpty = 0;
+    while(firstEmpty < board->tubeNum && state[firstEmpty*board->capacity] != BOARD_EMPTY) firstEmpty++;
+    for(int i = 0; i < moveNum; i++)
+        if(!pruned(board, state, moves[i], last, rules, firstEmpty)) moves[kept++] = moves[i];
+    PERF_END(PERF_PRUNE);
+    return kept;
+}
+
+bool boardSolved(const Board* board, const unsigned char* state){
+    // same condition as gameEnd: every tube is empty or full of one color
+    return stateSolved(state, boardSize(board), board->capacity);
+}
+
+int boardHeuristic(const Board* board, const unsigned char* state){
+    // (# of runs - # of colors) + (# of runs above the bottom run of each tube),
+    // 0 only for a solved board
+    int runs = 0, mixed = 0;
+    for(int i = 0; i < board->tubeNum; i++){
+        const unsigned char* tube = state+i*board->capacity;
+        if(tube[0] == BOARD_EMPTY) continue;
+        int tubeRuns = 1;
+        for(int j = 1; j < board->capacity && tube[j] != BOARD_EMPTY; j++)
+            if(tube[j] != tube[j-1]) tubeRuns++;
+        runs += tubeRuns;
+        mixed += tubeRuns-1;
+    }
+    return runs-board->colorNum+mixed;
+}
+
+static uint64_t mix64(uint64_t x){
+    // splitmix64 finalizer
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+uint64_t tubeHash(const unsigned char* tube, int capacity){
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for(int j = 0; j < capacity; j++){
+        h ^= tube[j];
+        h *= 0x100000001b3ULL;
+    }
+    return mix64(h);
+}
+
+uint64_t boardHash(const Board* board, const unsigned char* state){
+    // tubes are interchangeable, so the per-tube hashes are combined with a
+    // commutative sum: boards that only differ by tube order share a hash
+    PERF_BEGIN(PERF_HASH);
+    uint64_t h = 0;
+    for(int i = 0; i < board->tubeNum; i++)
+        h += tubeHash(state+i*board->capacity, board->capacity);
+    h = mix64(h);
+    PERF_END(PERF_HASH);
+    return h ? h : 1; // 0 marks empty hash table slots
+}
+
+uint64_t nextRandom(uint64_t* rng){
+    // splitmix64, the same sequence on every platform
+    *rng += 0x9e3779b97f4a7c15ULL;
+    return mix64(*rng);
+}
+
+static void boardPalette(Board* board){
+    // named raylib colors first, evenly spread hues for the rest
+    static const Color colors[] = { RED, BLUE, GREEN, YELLOW, PURPLE, ORANGE, PINK, SKYBLUE, LIME, GOLD,
+                                    VIOLET, MAROON, DARKBLUE, DARKGREEN, BEIGE, MAGENTA, BROWN, DARKPURPLE };
+    int named = sizeof(colors)/sizeof(colors[0]);
+    board->palette[BOARD_EMPTY] = BLANK;
+    for(int c = 1; c <= board->colorNum; c++)
+        board->palette[c] = c <= named ? colors[c-1] : ColorFromHSV(360.0f*(c-named)/(board->colorNum-named+1), 0.8f, 0.9f);
+}
+
+unsigned char* boardRandom(Board* board, int colorNum, int emptyNum, int capacity, uint64_t seed){
+    // shuffled level: colorNum full tubes worth of colors followed by emptyNum empty tubes
+    if(colorNum > BOARD_MAX_COLOR){
+        printf("Error: too many colors to pack the board\n");
+        exit(-1);
+    }
+    board->tubeNum = colorNum+emptyNum;
+    board->capacity = capacity;
+    board->colorNum = colorNum;
+    boardPalette(board);
+
+    unsigned char* state = calloc(boardSize(board), 1);
+    int units = colorNum*capacity;
+    for(int i = 0; i < units; i++) state[i] = i/capacity+1;
+    uint64_t rng = seed;
+    for(int i = units-1; i > 0; i--){
+        int j = nextRandom(&rng) % (i+1);
+        unsigned char tmp = state[i]; state[i] = state[j]; state[j] = tmp;
+    }
+    return state;
+}
+
+static int colorFromChar(char c){
+    if(c >= 'a' && c <= 'z') return c-'a'+1;
+    if(c >= 'A' && c <= 'Z') return c-'A'+27;
+    return -1;
+}
+
+unsigned char* boardParse(Board* board, const char* text){
+    // level text "<capacity>:<tube>,<tube>,..." with one letter per water unit
+    // from bottom to top ('a'-'z' then 'A'-'Z'), e.g. "4:abab,baba,,", NULL if malformed
+    char* end;
+    long capacity = strtol(text, &end, 10);
+    if(end == text || *end != ':' || capacity < MIN_TUBE_WATER || capacity > MAX_TUBE_WATER) return NULL;
+    const char* p = end+1;
+    int tubeNum = 1;
+    for(const char* q = p; *q && *q != ' ' && *q != '\n'; q++)
+        if(*q == ',') tubeNum++;
+    board->tubeNum = tubeNum;
+    board->capacity = capacity;
+    board->colorNum = 0;
+    unsigned char* state = calloc(boardSize(board), 1);
+    for(int i = 0, j = 0; ; p++){
+        if(*p == ',' || *p == ' ' || *p == '\n' || *p == '\r' || *p == 0){
+            if(*p != ','){
+                if(i != tubeNum-1) break;
+                boardPalette(board);
+                return state;
+            }
+            i++;
+            j = 0;
+            continue;
+        }
+        int id = colorFromChar(*p);
+        if(id < 0 || j == capacity) break;
+        state[i*capacity+j++] = id;
+        board->colorNum = max(board->colorNum, id);
+    }
+    free(state);
+    return NULL;
+}
+
+int boardReplay(const Board* board, unsigned char* state, const Move* moves, int moveNum){
+    // apply pours in order, returns the index of the first illegal one or moveNum
+    for(int i = 0; i < moveNum; i++){
+        if(moves[i].from < 0 || moves[i].from >= board->tubeNum || moves[i].to < 0 || moves[i].to >= board->tubeNum)
+            return i;
+        if(boardPour(board, state, moves[i].from, moves[i].to) == 0) return i;
+    }
+    return moveNum;
+}
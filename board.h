@@ -0,0 +1,62 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "raylib.h"
+#include "utils.h"
+
+#define BOARD_EMPTY         0   // color id of an empty water unit
+#define BOARD_MAX_COLOR     255 // color ids are stored in one byte
+
+// move pruning rules, see movePruned
+#define PRUNE_NONE          0
+#define PRUNE_EMPTY         1   // uniform tube into an empty tube, or into any but the first empty tube
+#define PRUNE_REVERSE       2   // pouring straight back what the last move poured
+#define PRUNE_SPLIT         4   // leaving part of a run behind without finishing the target tube
+#define PRUNE_COMMUTE       8   // independent pours are only taken in increasing (from, to) order
+#define PRUNE_SAFE          (PRUNE_EMPTY | PRUNE_REVERSE | PRUNE_COMMUTE) // keeps every solved board reachable
+#define PRUNE_ALL           (PRUNE_SAFE | PRUNE_SPLIT)
+
+// packed board used by solvers and tools: each tube is `capacity` color ids
+// stored bottom to top, the whole state is `tubeNum*capacity` bytes
+typedef struct Board {
+    int tubeNum;
+    int capacity;
+    int colorNum;
+    Color palette[BOARD_MAX_COLOR+1]; // palette[id] for id in [1, colorNum]
+} Board;
+
+typedef struct Move {
+    int from;
+    int to;
+    int count; // # of water units moved
+} Move;
+
+#define NO_MOVE             ((Move){ -1, -1, 0 })
+
+int boardSize(const Board* board);
+unsigned char* boardFromTubes(Board* board, const Tubes* tubes);
+void boardToTubes(const Board* board, const unsigned char* state, Tubes* tubes);
+Tubes* boardNewTubes(const Board* board, const unsigned char* state);
+
+int tubeLevel(const unsigned char* tube, int capacity);
+int tubeTopRun(const unsigned char* tube, int level);
+bool boardCanPour(const Board* board, const unsigned char* state, int from, int to);
+int boardPourCount(const Board* board, const unsigned char* state, int from, int to);
+int boardPour(const Board* board, unsigned char* state, int from, int to);
+void boardUnpour(const Board* board, unsigned char* state, Move move);
+int boardMoves(const Board* board, const unsigned char* state, Move* moves);
+bool movePruned(const Board* board, const unsigned char* state, Move move, Move last, int rules);
+int boardPrunedMoves(const Board* board, const unsigned char* state, Move last, int rules, Move* moves);
+bool boardSolved(const Board* board, const unsigned char* state);
+int boardHeuristic(const Board* board, const unsigned char* state);
+
+uint64_t tubeHash(const unsigned char* tube, int capacity);
+uint64_t boardHash(const Board* board, const unsigned char* state);
+uint64_t nextRandom(uint64_t* rng);
+unsigned char* boardRandom(Board* board, int colorNum, int emptyNum, int capacity, uint64_t seed);
+unsigned char* boardParse(Board* board, const char* text);
+int boardReplay(const Board* board, unsigned char* state, const Move* moves, int moveNum);
+
+#endif // BOARD_H
@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cache.h"
+
+static size_t cacheLength(uint32_t slotNum){
+    return sizeof(CacheHeader)+sizeof(CacheEntry)*(size_t)slotNum;
+}
+
+static void storePath(SolutionCache* cache, const Board* board, const unsigned char* start, const Move* moves, int moveNum){
+    // every board on the solution path gets its next pour and remaining distance
+    unsigned char* state = malloc(boardSize(board));
+    memcpy(state, start, boardSize(board));
+    for(int i = 0; i < moveNum; i++){
+        cacheStore(cache, board, state, moves[i], moveNum-i);
+        boardPour(board, state, moves[i].from, moves[i].to);
+    }
+    free(state);
+}
+
+static void* cacheWriter(void* arg){
+    SolutionCache* cache = arg;
+    pthread_mutex_lock(&cache->lock);
+    while(true){
+        while(!cache->head && !cache->stopping) pthread_cond_wait(&cache->wake, &cache->lock);
+        CacheWrite* write = cache->head;
+        if(!write) break;
+        cache->head = write->next;
+        if(!cache->head) cache->tail = NULL;
+        pthread_mutex_unlock(&cache->lock);
+        storePath(cache, &write->board, write->start, write->moves, write->moveNum);
+        free(write->start);
+        free(write->moves);
+        free(write);
+        pthread_mutex_lock(&cache->lock);
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return NULL;
+}
+
+SolutionCache* cacheOpen(const char* path){
+    // the first process to lock the file is the only writer, all others map it read only
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    bool writable = fd >= 0 && flock(fd, LOCK_EX | LOCK_NB) == 0;
+    if(fd < 0) fd = open(path, O_RDONLY);
+    if(fd < 0) return NULL;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0){
+        close(fd);
+        return NULL;
+    }
+    size_t length = cacheLength(CACHE_SLOT_NUM);
+    bool fresh = false;
+    if(writable && (size_t)st.st_size != length){
+        // new file or written by a different build, start over
+        if(ftruncate(fd, 0) != 0 || ftruncate(fd, length) != 0){
+            close(fd);
+            return NULL;
+        }
+        fresh = true;
+    } else if(!writable){
+        if((size_t)st.st_size < sizeof(CacheHeader)){
+            close(fd);
+            return NULL;
+        }
+        length = st.st_size;
+    }
+
+    void* mem = mmap(NULL, length, PROT_READ | (writable ? PROT_WRITE : 0), MAP_SHARED, fd, 0);
+    if(mem == MAP_FAILED){
+        close(fd);
+        return NULL;
+    }
+    SolutionCache* cache = malloc(sizeof(SolutionCache));
+    cache->fd = fd;
+    cache->writable = writable;
+    cache->length = length;
+    cache->header = mem;
+    cache->entries = (CacheEntry*)((char*)mem+sizeof(CacheHeader));
+
+    if(fresh || (writable && (cache->header->magic != CACHE_MAGIC || cache->header->version != CACHE_VERSION))){
+        memset(mem, 0, length);
+        cache->header->version = CACHE_VERSION;
+        cache->header->slotNum = CACHE_SLOT_NUM;
+        __atomic_store_n(&cache->header->magic, CACHE_MAGIC, __ATOMIC_RELEASE); // readers check the magic first
+    }
+    if(__atomic_load_n(&cache->header->magic, __ATOMIC_ACQUIRE) != CACHE_MAGIC ||
+       cache->header->version != CACHE_VERSION ||
+       cacheLength(cache->header->slotNum) != length){
+        cache->writable = false; // no writer thread to stop yet
+        cacheClose(cache);
+        return NULL;
+    }
+    if(writable){
+        pthread_mutex_init(&cache->lock, NULL);
+        pthread_cond_init(&cache->wake, NULL);
+        cache->head = cache->tail = NULL;
+        cache->stopping = false;
+        pthread_create(&cache->writer, NULL, cacheWriter, cache);
+    }
+    return cache;
+}
+
+void cacheClose(SolutionCache* cache){
+    // queued solutions are written before the file is closed
+    if(!cache) return;
+    if(cache->writable){
+        pthread_mutex_lock(&cache->lock);
+        cache->stopping = true;
+        pthread_cond_signal(&cache->wake);
+        pthread_mutex_unlock(&cache->lock);
+        pthread_join(cache->writer, NULL);
+        pthread_cond_destroy(&cache->wake);
+        pthread_mutex_destroy(&cache->lock);
+    }
+    munmap(cache->header, cache->length);
+    close(cache->fd); // also releases the writer lock
+    free(cache);
+}
+
+static CacheEntry* cacheBucket(SolutionCache* cache, uint64_t hash){
+    uint32_t bucketNum = cache->header->slotNum/CACHE_BUCKET_SIZE;
+    return cache->entries+(hash % bucketNum)*CACHE_BUCKET_SIZE;
+}
+
+static int findTube(const Board* board, const unsigned char* state, uint32_t tube, int skip){
+    for(int i = 0; i < board->tubeNum; i++)
+        if(i != skip && (uint32_t)tubeHash(state+i*board->capacity, board->capacity) == tube) return i;
+    return -1;
+}
+
+bool cacheLookup(SolutionCache* cache, const Board* board, const unsigned char* state, Move* move, int* distance){
+    if(!cache) return false;
+    uint64_t hash = boardHash(board, state);
+    CacheEntry* bucket = cacheBucket(cache, hash);
+    for(int i = 0; i < CACHE_BUCKET_SIZE; i++){
+        // seqlock read: retry-free, a torn entry is just a miss
+        CacheEntry* e = &bucket[i];
+        uint32_t seq = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE);
+        if(seq & 1) continue;
+        if(__atomic_load_n(&e->hash, __ATOMIC_RELAXED) != hash) continue;
+        uint32_t fromTube = __atomic_load_n(&e->fromTube, __ATOMIC_RELAXED);
+        uint32_t toTube   = __atomic_load_n(&e->toTube, __ATOMIC_RELAXED);
+        uint32_t dist     = __atomic_load_n(&e->distance, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(__atomic_load_n(&e->seq, __ATOMIC_RELAXED) != seq) continue;
+
+        int from = findTube(board, state, fromTube, -1);
+        int to = from < 0 ? -1 : findTube(board, state, toTube, from);
+        if(to < 0 || !boardCanPour(board, state, from, to)) return false; // hash collision
+        *move = (Move){ from, to, boardPourCount(board, state, from, to) };
+        *distance = dist;
+        return true;
+    }
+    return false;
+}
+
+void cacheStore(SolutionCache* cache, const Board* board, const unsigned char* state, Move move, int distance){
+    // from the writer thread only, other threads go through cacheStoreSolution
+    if(!cache || !cache->writable) return;
+    uint64_t hash = boardHash(board, state);
+    CacheEntry* bucket = cacheBucket(cache, hash);
+    CacheEntry* victim = NULL;
+    for(int i = 0; i < CACHE_BUCKET_SIZE; i++){
+        if(bucket[i].hash == hash){
+            if(bucket[i].distance <= (uint32_t)distance) return; // keep the shorter solution
+            victim = &bucket[i];
+            break;
+        }
+    }
+    for(int i = 0; i < CACHE_BUCKET_SIZE && !victim; i++)
+        if(bucket[i].hash == 0) victim = &bucket[i];
+    if(!victim){
+        victim = &bucket[0];
+        for(int i = 1; i < CACHE_BUCKET_SIZE; i++)
+            if((int32_t)(bucket[i].stamp-victim->stamp) < 0) victim = &bucket[i];
+    }
+
+    uint32_t seq = victim->seq;
+    __atomic_store_n(&victim->seq, seq+1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&victim->stamp, ++cache->header->stamp, __ATOMIC_RELAXED);
+    __atomic_store_n(&victim->hash, hash, __ATOMIC_RELAXED);
+    __atomic_store_n(&victim->fromTube, (uint32_t)tubeHash(state+move.from*board->capacity, board->capacity), __ATOMIC_RELAXED);
+    __atomic_store_n(&victim->toTube, (uint32_t)tubeHash(state+move.to*board->capacity, board->capacity), __ATOMIC_RELAXED);
+    __atomic_store_n(&victim->distance, (uint32_t)distance, __ATOMIC_RELAXED);
+    __atomic_store_n(&victim->seq, seq+2, __ATOMIC_RELEASE);
+}
+
+void cacheStoreSolution(SolutionCache* cache, const Board* board, const unsigned char* start, Solution* solution){
+    // queues a copy for the writer thread, safe from any thread
+    if(!cache || !cache->writable || !solution->solved || solution->moveNum == 0) return;
+    CacheWrite* write = malloc(sizeof(CacheWrite));
+    write->board = *board;
+    write->start = malloc(boardSize(board));
+    memcpy(write->start, start, boardSize(board));
+    write->moves = malloc(sizeof(Move)*solution->moveNum);
+    memcpy(write->moves, solution->moves, sizeof(Move)*solution->moveNum);
+    write->moveNum = solution->moveNum;
+    write->next = NULL;
+    pthread_mutex_lock(&cache->lock);
+    if(cache->tail) cache->tail->next = write;
+    else cache->head = write;
+    cache->tail = write;
+    pthread_cond_signal(&cache->wake);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+Solution cachedSearch(SolutionCache* cache, const Board* board, const unsigned char* start, int beamWidth, int maxDepth,
+                      int threadNum){
+    // follow cached pours as far as they go, then search the rest
+    unsigned char* state = malloc(boardSize(board));
+    memcpy(state, start, boardSize(board));
+    Move* chain = malloc(sizeof(Move)*maxDepth);
+    int chainNum = 0, lastDistance = maxDepth+1;
+    Move move;
+    int distance;
+    while(chainNum < maxDepth && !boardSolved(board, state) && cacheLookup(cache, board, state, &move, &distance)){
+        if(distance >= lastDistance) break; // distances must shrink, otherwise entries form a loop
+        lastDistance = distance;
+        boardPour(board, state, move.from, move.to);
+        chain[chainNum++] = move;
+    }
+
+    Solution solution;
+    if(boardSolved(board, state)){
+        solution = (Solution){ true, chainNum, chain, 0 };
+    } else {
+        Solution rest = beamSearch(board, state, beamWidth, maxDepth-chainNum, threadNum);
+        solution = (Solution){ rest.solved, 0, NULL, rest.expanded };
+        if(rest.solved){
+            solution.moveNum = chainNum+rest.moveNum;
+            solution.moves = realloc(chain, sizeof(Move)*max(solution.moveNum, 1));
+            memcpy(solution.moves+chainNum, rest.moves, sizeof(Move)*rest.moveNum);
+            chain = NULL;
+            cacheStoreSolution(cache, board, start, &solution);
+        }
+        freeSolution(&rest);
+        free(chain);
+    }
+    free(state);
+    return solution;
+}
@@ -0,0 +1,65 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <pthread.h>
+#include "solver.h"
+
+#define CACHE_FILE          "solutions.cache"
+#define CACHE_MAGIC         0x3145484341435357ULL // "WSCACHE1"
+#define CACHE_VERSION       1
+#define CACHE_SLOT_NUM      (1 << 18)   // 8 MB file
+#define CACHE_BUCKET_SIZE   8           // slots probed per hash, one is evicted when all are taken
+
+// one cached board: the best known next pour and the # of pours left,
+// tubes are named by their content hash so the entry holds for any tube order
+typedef struct CacheEntry {
+    uint32_t seq;       // odd while the writer is updating the entry
+    uint32_t stamp;     // insertion order, the oldest entry of a bucket is evicted
+    uint64_t hash;      // boardHash, 0 for empty slots
+    uint32_t fromTube;  // low 32 bits of tubeHash of the source tube
+    uint32_t toTube;
+    uint32_t distance;
+    uint32_t reserved;
+} CacheEntry;
+
+typedef struct CacheHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t slotNum;
+    uint32_t stamp;     // last used insertion stamp
+    uint32_t reserved[11];
+} CacheHeader;
+
+// a solution waiting for the writer thread
+typedef struct CacheWrite {
+    Board board;
+    unsigned char* start;
+    Move* moves;
+    int moveNum;
+    struct CacheWrite* next;
+} CacheWrite;
+
+typedef struct SolutionCache {
+    int fd;
+    bool writable;      // only the process holding the file lock writes
+    size_t length;
+    CacheHeader* header;
+    CacheEntry* entries;
+    // solutions are stored by one writer thread, so callers never wait on the file
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    CacheWrite* head;   // oldest queued solution
+    CacheWrite* tail;
+    bool stopping;
+} SolutionCache;
+
+SolutionCache* cacheOpen(const char* path);
+void cacheClose(SolutionCache* cache);
+bool cacheLookup(SolutionCache* cache, const Board* board, const unsigned char* state, Move* move, int* distance);
+void cacheStore(SolutionCache* cache, const Board* board, const unsigned char* state, Move move, int distance);
+void cacheStoreSolution(SolutionCache* cache, const Board* board, const unsigned char* start, Solution* solution);
+Solution cachedSearch(SolutionCache* cache, const Board* board, const unsigned char* start, int beamWidth, int maxDepth,
+                      int threadNum);
+
+#endif // CACHE_H
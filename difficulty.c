@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "difficulty.h"
+#include "arena.h"
+#include "trace.h"
+
+typedef struct SearchSpace {
+    NodeStore nodes;        // boards with the pour that first reached them, by index
+    size_t cap;             // of count and hashes
+    double* count;          // # of shortest pour sequences reaching each board
+    uint64_t* hashes;
+    uint32_t* slots;        // board index+1, 0 for empty slots
+    size_t mask;
+} SearchSpace;
+
+typedef struct RateJob {
+    SolutionCache* cache;   // optimal solutions are stored here, NULL for none
+    const Board* boards;
+    unsigned char** starts;
+    Difficulty* results;
+    int levelNum;
+    int next;               // next level to rate, shared by all workers
+} RateJob;
+
+static uint32_t spaceMaxNodes(const Board* board){
+    // the search stops expanding at DIFFICULTY_MAX_STATES, the last board expanded may add all its pours
+    return DIFFICULTY_MAX_STATES+board->tubeNum*max(board->tubeNum-1, 1);
+}
+
+static void spaceTables(SearchSpace* space){
+    space->cap = 1024;
+    space->count = malloc(space->cap*sizeof(double));
+    space->hashes = malloc(space->cap*sizeof(uint64_t));
+    space->mask = space->cap*2-1;
+    space->slots = calloc(space->mask+1, sizeof(uint32_t));
+}
+
+static void spaceFreeTables(SearchSpace* space){
+    free(space->count);
+    free(space->hashes);
+    free(space->slots);
+}
+
+static void spaceInit(SearchSpace* space, const Board* board){
+    nodeStoreInit(&space->nodes, board, spaceMaxNodes(board));
+    spaceTables(space);
+}
+
+static void spaceReset(SearchSpace* space, const Board* board){
+    // empty for a search of board, the node store keeps its pages. the tables start
+    // small again so a large level does not slow down the small ones after it
+    nodeStoreReset(&space->nodes, board, spaceMaxNodes(board));
+    spaceFreeTables(space);
+    spaceTables(space);
+}
+
+static void spaceFree(SearchSpace* space){
+    nodeStoreFree(&space->nodes);
+    spaceFreeTables(space);
+}
+
+static size_t spaceFind(const SearchSpace* space, uint64_t hash){
+    // slot of `hash`, or of the empty slot it would go to
+    size_t i = hash & space->mask;
+    while(space->slots[i] && space->hashes[space->slots[i]-1] != hash) i = (i+1) & space->mask;
+    return i;
+}
+
+static Move spaceLast(const SearchSpace* space, size_t idx){
+    // pour that first reached board idx
+    const SearchNode* node = nodeAt(&space->nodes, idx);
+    return node->parent == NODE_NONE ? NO_MOVE : (Move){ node->from, node->to, node->count };
+}
+
+static size_t spaceAdd(SearchSpace* space, const unsigned char* state, uint64_t hash, uint32_t parent, Move last,
+                       int depth, double count){
+    if(space->nodes.num == space->cap){
+        space->cap *= 2;
+        space->count = realloc(space->count, space->cap*sizeof(double));
+        space->hashes = realloc(space->hashes, space->cap*sizeof(uint64_t));
+        free(space->slots);
+        space->mask = space->cap*2-1;
+        space->slots = calloc(space->mask+1, sizeof(uint32_t));
+        for(size_t i = 0; i < space->nodes.num; i++)
+            space->slots[spaceFind(space, space->hashes[i])] = i+1;
+    }
+    size_t idx = nodeAdd(&space->nodes, state, parent, last, depth);
+    space->count[idx] = count;
+    space->hashes[idx] = hash;
+    space->slots[spaceFind(space, hash)] = idx+1;
+    return idx;
+}
+
+static double effectiveBranching(long long nodes, int depth){
+    // b such that b + b^2 + ... + b^depth = nodes
+    if(depth <= 0 || nodes <= depth) return 1.0;
+    double lo = 1.0, hi = (double)nodes;
+    for(int it = 0; it < 60; it++){
+        double b = (lo+hi)/2, sum = 0, term = 1;
+        for(int d = 0; d < depth && sum <= nodes; d++){
+            term *= b;
+            sum += term;
+        }
+        if(sum > nodes) hi = b;
+        else lo = b;
+    }
+    return (lo+hi)/2;
+}
+
+static void exactSearch(SearchSpace* space, SolutionCache* cache, const Board* board, const unsigned char* start,
+                        Difficulty* result){
+    // breadth-first search over canonical boards, finishing the layer of the first
+    // solved board so every shortest solution is counted. space is empty and set up for board
+    int size = boardSize(board);
+    Move* moves = malloc(sizeof(Move)*board->tubeNum*max(board->tubeNum-1, 1));
+    unsigned char* parent = malloc(size);
+    unsigned char* child = malloc(size);
+    spaceAdd(space, start, boardHash(board, start), NODE_NONE, NO_MOVE, 0, 1.0);
+    int solvedDepth = boardSolved(board, start) ? 0 : -1;
+    uint32_t goal = 0;      // first solved board found
+    long long expanded = 0, edges = 0, deadEnds = 0;
+    size_t head = 0;
+    result->exact = true;
+    while(head < space->nodes.num){
+        int headDepth = nodeAt(&space->nodes, head)->depth;
+        if(solvedDepth >= 0 && headDepth >= solvedDepth) break;
+        if(space->nodes.num >= DIFFICULTY_MAX_STATES){
+            result->exact = false;
+            break;
+        }
+        nodeBoard(&space->nodes, head, parent);
+        Move last = spaceLast(space, head);
+        if(boardPrunedMoves(board, parent, last, PRUNE_EMPTY | PRUNE_REVERSE, moves) == 0) deadEnds++;
+        int moveNum = boardPrunedMoves(board, parent, last, PRUNE_SAFE, moves);
+        expanded++;
+        edges += moveNum;
+        for(int m = 0; m < moveNum; m++){
+            memcpy(child, parent, size);
+            boardPour(board, child, moves[m].from, moves[m].to);
+            uint64_t hash = boardHash(board, child);
+            size_t slot = spaceFind(space, hash);
+            if(space->slots[slot]){
+                size_t idx = space->slots[slot]-1;
+                if(nodeAt(&space->nodes, idx)->depth == headDepth+1) space->count[idx] += space->count[head];
+                continue;
+            }
+            int depth = headDepth+1;
+            uint32_t idx = spaceAdd(space, child, hash, head, moves[m], depth, space->count[head]);
+            if(solvedDepth < 0 && boardSolved(board, child)){
+                solvedDepth = depth;
+                goal = idx;
+            }
+        }
+        head++;
+    }
+
+    result->solvable = solvedDepth >= 0;
+    result->states = space->nodes.num;
+    result->deadEndRatio = expanded ? 1.0*deadEnds/expanded : 0.0;
+    result->solutions = 0;
+    if(result->solvable){
+        result->optimalLength = solvedDepth;
+        for(size_t i = 0; i < space->nodes.num; i++){
+            if(nodeAt(&space->nodes, i)->depth != solvedDepth) continue;
+            nodeBoard(&space->nodes, i, child);
+            if(boardSolved(board, child)) result->solutions += space->count[i];
+        }
+        result->branching = effectiveBranching(space->nodes.num-1, solvedDepth);
+        Solution solution = { true, solvedDepth, malloc(sizeof(Move)*max(solvedDepth, 1)), 0 };
+        nodePath(&space->nodes, goal, solution.moves);
+        cacheStoreSolution(cache, board, start, &solution);
+        freeSolution(&solution);
+    } else {
+        result->optimalLength = 0;
+        result->branching = expanded ? 1.0*edges/expanded : 0.0;
+    }
+    free(child);
+    free(parent);
+    free(moves);
+}
+
+static double randomPlay(const Board* board, const unsigned char* start, uint64_t seed){
+    // ratio of random games solving the level, never pouring straight back
+    uint64_t rng = seed;
+    int size = boardSize(board), success = 0;
+    unsigned char* state = malloc(size);
+    Move* moves = malloc(sizeof(Move)*board->tubeNum*max(board->tubeNum-1, 1));
+    for(int p = 0; p < DIFFICULTY_PLAYOUTS; p++){
+        memcpy(state, start, size);
+        Move last = NO_MOVE;
+        for(int k = 0; k < DIFFICULTY_PLAYOUT_LEN && !boardSolved(board, state); k++){
+            int moveNum = boardPrunedMoves(board, state, last, PRUNE_EMPTY | PRUNE_REVERSE, moves);
+            if(moveNum == 0) break;
+            last = moves[nextRandom(&rng) % moveNum];
+            boardPour(board, state, last.from, last.to);
+        }
+        if(boardSolved(board, state)) success++;
+    }
+    free(moves);
+    free(state);
+    return 1.0*success/DIFFICULTY_PLAYOUTS;
+}
+
+static Difficulty rateInSpace(SearchSpace* space, SolutionCache* cache, const Board* board, const unsigned char* start,
+                              uint64_t seed){
+    Difficulty result;
+    exactSearch(space, cache, board, start, &result);
+    if(!result.exact){
+        // too large to search exhaustively, the beam search gives an upper bound.
+        // one thread: rateLevels already runs a level per core
+        Solution solution = cachedSearch(cache, board, start, BEAM_WIDTH, BEAM_MAX_DEPTH, 1);
+        result.solvable = solution.solved;
+        result.optimalLength = solution.moveNum;
+        result.solutions = solution.solved ? 1 : 0;
+        freeSolution(&solution);
+    }
+    result.randomSuccess = randomPlay(board, start, seed);
+
+    if(!result.solvable){
+        result.score = 10.0;
+        return result;
+    }
+    double z = DIFFICULTY_W_LENGTH*log2(1.0+result.optimalLength)
+             + DIFFICULTY_W_BRANCHING*log(max(result.branching, 1.0))
+             + DIFFICULTY_W_DEAD_END*result.deadEndRatio
+             - DIFFICULTY_W_RANDOM*log2(result.randomSuccess+1.0/DIFFICULTY_PLAYOUTS)
+             - DIFFICULTY_W_SOLUTIONS*log2(max(result.solutions, 1.0));
+    result.score = z > 0 ? 10.0*(1.0-exp(-z/6.0)) : 0.0;
+    return result;
+}
+
+Difficulty rateLevel(SolutionCache* cache, const Board* board, const unsigned char* start, uint64_t seed){
+    SearchSpace space;
+    spaceInit(&space, board);
+    Difficulty result = rateInSpace(&space, cache, board, start, seed);
+    spaceFree(&space);
+    return result;
+}
+
+static void* rateWorker(void* arg){
+    // one search space per worker, reset between its levels instead of mapped again
+    RateJob* job = arg;
+    SearchSpace space;
+    int idx, rated = 0;
+    while((idx = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->levelNum){
+        TRACE_BEGIN("rateLevel");
+        if(rated++ == 0) spaceInit(&space, &job->boards[idx]);
+        else spaceReset(&space, &job->boards[idx]);
+        job->results[idx] = rateInSpace(&space, job->cache, &job->boards[idx], job->starts[idx], idx+1);
+        TRACE_END("rateLevel");
+    }
+    if(rated > 0) spaceFree(&space);
+    return NULL;
+}
+
+void rateLevels(SolutionCache* cache, const Board* boards, unsigned char** starts, int levelNum, Difficulty* results){
+    // levels are rated independently, one per core at a time
+    RateJob job = { cache, boards, starts, results, levelNum, 0 };
+    int threadNum = min(solverThreadNum(), max(levelNum, 1));
+    pthread_t* threads = malloc(sizeof(pthread_t)*threadNum);
+    for(int t = 1; t < threadNum; t++) pthread_create(&threads[t], NULL, rateWorker, &job);
+    rateWorker(&job);
+    for(int t = 1; t < threadNum; t++) pthread_join(threads[t], NULL);
+    free(threads);
+}
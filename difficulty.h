@@ -0,0 +1,33 @@
+#ifndef DIFFICULTY_H
+#define DIFFICULTY_H
+
+#include "solver.h"
+#include "cache.h"
+
+#define DIFFICULTY_MAX_STATES   (1 << 20) // exact search gives up after this many boards
+#define DIFFICULTY_PLAYOUTS     256       // random games per level
+#define DIFFICULTY_PLAYOUT_LEN  200       // pours per random game
+
+// weights of the score (0 easy - 10 hard), refit them when hand-tagged levels are added
+#define DIFFICULTY_W_LENGTH     1.10
+#define DIFFICULTY_W_BRANCHING  0.80
+#define DIFFICULTY_W_DEAD_END   2.50
+#define DIFFICULTY_W_RANDOM     0.60
+#define DIFFICULTY_W_SOLUTIONS  0.05
+
+typedef struct Difficulty {
+    bool solvable;
+    bool exact;             // false if the state limit was hit and optimalLength is a beam search bound
+    int optimalLength;      // # of pours of the shortest solution
+    long long states;       // # of distinct boards explored
+    double branching;       // effective branching factor of the exact search
+    double deadEndRatio;    // explored boards with no useful pour left
+    double solutions;       // # of distinct optimal solutions, independent pours in any order count once
+    double randomSuccess;   // ratio of random games that solve the level
+    double score;
+} Difficulty;
+
+Difficulty rateLevel(SolutionCache* cache, const Board* board, const unsigned char* start, uint64_t seed);
+void rateLevels(SolutionCache* cache, const Board* boards, unsigned char** starts, int levelNum, Difficulty* results);
+
+#endif // DIFFICULTY_H
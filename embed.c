@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "raylib.h"
+
+// decodes images at build time into raw RGBA pixels, so the game skips decoding and
+// file reads at startup:
+//   ./embed <name> <image> ...
+// writes <name>.bin with the pixels of every image, 16 byte aligned, and <name>.c with
+// the ASSETS table (see asset.h) pointing into it through .incbin
+
+#define EMBED_ALIGN         16
+
+int main(int argc, char** argv){
+    if(argc < 3){
+        printf("Usage: ./embed <name> <image> ...\n");
+        return -1;
+    }
+    char binPath[4096], sourcePath[4096];
+    snprintf(binPath, sizeof(binPath), "%s.bin", argv[1]);
+    snprintf(sourcePath, sizeof(sourcePath), "%s.c", argv[1]);
+    FILE* bin = fopen(binPath, "wb");
+    FILE* source = fopen(sourcePath, "w");
+    if(!bin || !source){
+        printf("Error: cannot write %s\n", argv[1]);
+        exit(-1);
+    }
+    SetTraceLogLevel(LOG_WARNING);
+    fprintf(source, "// generated by embed, do not edit\n#include \"asset.h\"\n\n");
+    fprintf(source, "__asm__(\".section .rodata\\n.balign %d\\nassetPixels:\\n.incbin \\\"%s\\\"\\n.previous\\n\");\n", EMBED_ALIGN, binPath);
+    fprintf(source, "extern const unsigned char assetPixels[];\n\nconst Asset ASSETS[] = {\n");
+    long offset = 0;
+    for(int i = 2; i < argc; i++){
+        Image image = LoadImage(argv[i]);
+        if(!image.data){
+            printf("Error: cannot decode %s\n", argv[i]);
+            exit(-1);
+        }
+        ImageFormat(&image, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+        long size = (long)image.width*image.height*4;
+        fwrite(image.data, 1, size, bin);
+        // name: file name without directory and extension
+        const char* file = strrchr(argv[i], '/') ? strrchr(argv[i], '/')+1 : argv[i];
+        int nameLength = strchr(file, '.') ? strchr(file, '.')-file : (int)strlen(file);
+        fprintf(source, "    { \"%.*s\", %d, %d, %d, assetPixels+%ld },\n", nameLength, file, image.width, image.height,
+                PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, offset);
+        offset += size;
+        for(; offset % EMBED_ALIGN; offset++) fputc(0, bin);
+        UnloadImage(image);
+    }
+    fprintf(source, "};\nconst int ASSET_NUM = %d;\n", argc-2);
+    fclose(bin);
+    fclose(source);
+    return 0;
+}
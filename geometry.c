@@ -0,0 +1,145 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+#include <pthread.h>
+#include "geometry.h"
+#include "rlgl.h"
+#include "solver.h"
+
+static void addTriangles(Geometry* geometry, int count, const Vector2* vertices, Color color){
+    // count/3 triangles, a new run starts when the last one is full
+    if(geometry->runNum == 0 || geometry->runs[geometry->runNum-1]+count > GEOMETRY_RUN_MAX){
+        if(geometry->runNum == geometry->runCap){
+            geometry->runCap = geometry->runCap ? 2*geometry->runCap : 16;
+            geometry->runs = realloc(geometry->runs, sizeof(geometry->runs[0])*geometry->runCap);
+        }
+        geometry->runs[geometry->runNum++] = 0;
+    }
+    if(geometry->vertexNum+count > geometry->vertexCap){
+        geometry->vertexCap = geometry->vertexCap ? 2*geometry->vertexCap : 1024;
+        geometry->vertices = realloc(geometry->vertices, sizeof(Vector2)*geometry->vertexCap);
+        geometry->colors = realloc(geometry->colors, sizeof(Color)*geometry->vertexCap);
+    }
+    for(int i = 0; i < count; i++){
+        geometry->vertices[geometry->vertexNum] = vertices[i];
+        geometry->colors[geometry->vertexNum++] = color;
+    }
+    geometry->runs[geometry->runNum-1] += count;
+}
+
+void geometryClear(Geometry* geometry){
+    // keeps the storage for the next frame
+    geometry->vertexNum = 0;
+    geometry->runNum = 0;
+}
+
+void geometryFree(Geometry* geometry){
+    free(geometry->vertices);
+    free(geometry->colors);
+    free(geometry->runs);
+}
+
+void geometryTriangle(Geometry* geometry, Vector2 v1, Vector2 v2, Vector2 v3, Color color){
+    // counter-clockwise like DrawTriangle
+    addTriangles(geometry, 3, (Vector2[]){ v1, v2, v3 }, color);
+}
+
+void geometryRectangle(Geometry* geometry, Vector2 position, Vector2 size, Color color){
+    Vector2 topLeft     = position,
+            topRight    = (Vector2){ position.x+size.x, position.y },
+            bottomLeft  = (Vector2){ position.x, position.y+size.y },
+            bottomRight = (Vector2){ position.x+size.x, position.y+size.y };
+    addTriangles(geometry, 6, (Vector2[]){ topLeft, bottomLeft, topRight, topRight, bottomLeft, bottomRight }, color);
+}
+
+void geometrySector(Geometry* geometry, Vector2 center, float radius, float startAngle, float endAngle, int segments, Color color){
+    // angles in degrees
+    float step = (endAngle-startAngle)/segments*DEG2RAD, angle = startAngle*DEG2RAD;
+    for(int i = 0; i < segments; i++, angle += step){
+        Vector2 current = (Vector2){ center.x+cosf(angle)*radius, center.y+sinf(angle)*radius },
+                next    = (Vector2){ center.x+cosf(angle+step)*radius, center.y+sinf(angle+step)*radius };
+        addTriangles(geometry, 3, (Vector2[]){ center, next, current }, color);
+    }
+}
+
+void geometryDraw(const Geometry* geometry){
+    // main thread only, one rlgl draw per run at most
+    const Vector2* v = geometry->vertices;
+    const Color* c = geometry->colors;
+    for(int r = 0; r < geometry->runNum; r++){
+        int count = geometry->runs[r];
+        rlCheckRenderBatchLimit(count);
+        rlBegin(RL_TRIANGLES);
+        for(int i = 0; i < count; i++){
+            rlColor4ub(c[i].r, c[i].g, c[i].b, c[i].a);
+            rlVertex2f(v[i].x, v[i].y);
+        }
+        rlEnd();
+        v += count;
+        c += count;
+    }
+}
+
+// pool of workers kept between frames, woken by a new generation
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t poolStart = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t poolDone = PTHREAD_COND_INITIALIZER;
+static bool poolStarted = false;
+static int poolThreadNum = 0;
+static long poolGeneration = 0;
+static int poolBusy = 0;
+static void (*poolJob)(void* context, int i);
+static void* poolContext;
+static int poolJobNum;
+static int poolNext;
+
+static void runJobs(void){
+    int i;
+    while((i = __atomic_fetch_add(&poolNext, 1, __ATOMIC_RELAXED)) < poolJobNum) poolJob(poolContext, i);
+}
+
+static void* poolWorker(void* arg){
+    long seen = 0;
+    pthread_mutex_lock(&poolLock);
+    while(1){
+        while(poolGeneration == seen) pthread_cond_wait(&poolStart, &poolLock);
+        seen = poolGeneration;
+        pthread_mutex_unlock(&poolLock);
+        runJobs();
+        pthread_mutex_lock(&poolLock);
+        if(--poolBusy == 0) pthread_cond_signal(&poolDone);
+    }
+    return NULL;
+}
+
+void parallelFor(int n, void (*job)(void* context, int i), void* context){
+    // job(context, i) for i in [0, n) on the calling thread and the pool, returns when all are done
+    if(!poolStarted){
+        poolStarted = true;
+        int threadNum = solverThreadNum() < GEOMETRY_MAX_THREADS ? solverThreadNum() : GEOMETRY_MAX_THREADS;
+        for(int t = 1; t < threadNum; t++){
+            pthread_t thread;
+            if(pthread_create(&thread, NULL, poolWorker, NULL) == 0){
+                pthread_detach(thread);
+                poolThreadNum++;
+            }
+        }
+    }
+    if(poolThreadNum == 0 || n < 2){
+        for(int i = 0; i < n; i++) job(context, i);
+        return;
+    }
+    pthread_mutex_lock(&poolLock);
+    poolJob = job;
+    poolContext = context;
+    poolJobNum = n;
+    poolNext = 0;
+    poolBusy = poolThreadNum;
+    poolGeneration++;
+    pthread_cond_broadcast(&poolStart);
+    pthread_mutex_unlock(&poolLock);
+    runJobs();
+    pthread_mutex_lock(&poolLock);
+    while(poolBusy > 0) pthread_cond_wait(&poolDone, &poolLock);
+    pthread_mutex_unlock(&poolLock);
+}
@@ -0,0 +1,30 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include "raylib.h"
+
+#define GEOMETRY_RUN_MAX        3072    // vertices per run, whole triangles that fit one rlgl batch
+#define GEOMETRY_PARALLEL_MIN   16      // fewer tubes are built on the main thread
+#define GEOMETRY_MAX_THREADS    8       // drawing threads, the calling one included
+
+// triangle vertices of one tube in draw order, cut in runs of one rlgl batch.
+// built on any thread without raylib calls, drawn on the main thread by geometryDraw
+typedef struct Geometry {
+    Vector2* vertices;
+    Color* colors;
+    int vertexNum;
+    int vertexCap;
+    int* runs;          // # of vertices
+    int runNum;
+    int runCap;
+} Geometry;
+
+void geometryClear(Geometry* geometry);
+void geometryFree(Geometry* geometry);
+void geometryTriangle(Geometry* geometry, Vector2 v1, Vector2 v2, Vector2 v3, Color color);
+void geometryRectangle(Geometry* geometry, Vector2 position, Vector2 size, Color color);
+void geometrySector(Geometry* geometry, Vector2 center, float radius, float startAngle, float endAngle, int segments, Color color);
+void geometryDraw(const Geometry* geometry);
+void parallelFor(int n, void (*job)(void* context, int i), void* context);
+
+#endif // GEOMETRY_H
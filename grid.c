@@ -0,0 +1,75 @@
+#include <stdlib.h>
+#include "grid.h"
+
+static int clampCell(float pos, float cellSize, int cellNum){
+    int cell = (int)(pos/cellSize);
+    if(pos < 0 || cell < 0) return 0;
+    return cell < cellNum ? cell : cellNum-1;
+}
+
+static void cellAdd(TubeGrid* grid, int cell, int idx){
+    if(grid->cellCount[cell] == grid->cellCap[cell]){
+        grid->cellCap[cell] = grid->cellCap[cell] ? 2*grid->cellCap[cell] : 4;
+        grid->cells[cell] = realloc(grid->cells[cell], sizeof(int)*grid->cellCap[cell]);
+    }
+    grid->cells[cell][grid->cellCount[cell]++] = idx;
+}
+
+static void cellRemove(TubeGrid* grid, int cell, int idx){
+    // order inside a cell does not matter, the last entry fills the hole
+    for(int i = 0; i < grid->cellCount[cell]; i++)
+        if(grid->cells[cell][i] == idx){
+            grid->cells[cell][i] = grid->cells[cell][--grid->cellCount[cell]];
+            return;
+        }
+}
+
+TubeGrid* newTubeGrid(int tubeNum, float width, float height, float cellSize){
+    // tubes are not in any cell until their first tubeGridMove. cells are at least
+    // a pixel wide, tubes of a degenerate layout may be 0 wide
+    TubeGrid* grid = calloc(1, sizeof(TubeGrid));
+    grid->cellSize = cellSize < 1 ? 1 : cellSize;
+    grid->cols = (int)(width/grid->cellSize)+1;
+    grid->rows = (int)(height/grid->cellSize)+1;
+    grid->tubeNum = tubeNum;
+    grid->cells = calloc(grid->cols*grid->rows, sizeof(int*));
+    grid->cellCount = calloc(grid->cols*grid->rows, sizeof(int));
+    grid->cellCap = calloc(grid->cols*grid->rows, sizeof(int));
+    grid->box = calloc(tubeNum, sizeof(Rectangle));
+    grid->range = malloc(sizeof(grid->range[0])*tubeNum);
+    for(int i = 0; i < tubeNum; i++) grid->range[i][0] = -1;
+    return grid;
+}
+
+void freeTubeGrid(TubeGrid* grid){
+    if(!grid) return;
+    for(int i = 0; i < grid->cols*grid->rows; i++) free(grid->cells[i]);
+    free(grid->cells);
+    free(grid->cellCount);
+    free(grid->cellCap);
+    free(grid->box);
+    free(grid->range);
+    free(grid);
+}
+
+void tubeGridMove(TubeGrid* grid, int idx, Rectangle box){
+    // cells are only touched when the covered range changes, a tube moving inside its cells is free
+    int range[4] = { clampCell(box.x, grid->cellSize, grid->cols), clampCell(box.y, grid->cellSize, grid->rows),
+                     clampCell(box.x+box.width, grid->cellSize, grid->cols), clampCell(box.y+box.height, grid->cellSize, grid->rows) };
+    int* old = grid->range[idx];
+    grid->box[idx] = box;
+    if(old[0] == range[0] && old[1] == range[1] && old[2] == range[2] && old[3] == range[3]) return;
+    if(old[0] != -1)
+        for(int y = old[1]; y <= old[3]; y++)
+            for(int x = old[0]; x <= old[2]; x++) cellRemove(grid, y*grid->cols+x, idx);
+    for(int y = range[1]; y <= range[3]; y++)
+        for(int x = range[0]; x <= range[2]; x++) cellAdd(grid, y*grid->cols+x, idx);
+    for(int i = 0; i < 4; i++) old[i] = range[i];
+}
+
+int tubeGridQuery(const TubeGrid* grid, Vector2 pos, const int** candidates){
+    // tubes whose box may hold pos, returns the # of them
+    int cell = clampCell(pos.y, grid->cellSize, grid->rows)*grid->cols+clampCell(pos.x, grid->cellSize, grid->cols);
+    *candidates = grid->cells[cell];
+    return grid->cellCount[cell];
+}
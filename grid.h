@@ -0,0 +1,29 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <stdbool.h>
+#include "raylib.h"
+
+#define GRID_CELL_TUBES     1.25    // side of a cell in tube widths, about one tube apart
+
+// uniform grid over the tubes' bounding boxes for hit-testing: a point only
+// looks at the tubes whose box covers its cell. boxes outside the grid are
+// clamped to the border cells, so the grid size only matters for speed
+typedef struct TubeGrid {
+    float cellSize;
+    int cols;
+    int rows;
+    int tubeNum;
+    int** cells;        // tube indices in each cell, row major
+    int* cellCount;
+    int* cellCap;
+    Rectangle* box;     // bounding box of each tube
+    int (*range)[4];    // cells covered by each tube: first col, first row, last col, last row
+} TubeGrid;
+
+TubeGrid* newTubeGrid(int tubeNum, float width, float height, float cellSize);
+void freeTubeGrid(TubeGrid* grid);
+void tubeGridMove(TubeGrid* grid, int idx, Rectangle box);
+int tubeGridQuery(const TubeGrid* grid, Vector2 pos, const int** candidates);
+
+#endif // GRID_H
@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "history.h"
+
+static unsigned char* checkpointState(History* history, long long position){
+    int slot = (position/HISTORY_CHECKPOINT_EVERY) % HISTORY_CHECKPOINT_NUM;
+    return history->checkpoints+(size_t)slot*boardSize(&history->board);
+}
+
+static void saveCheckpoint(History* history){
+    // called whenever `current` reaches a multiple of HISTORY_CHECKPOINT_EVERY by a new pour
+    int slot = (history->current/HISTORY_CHECKPOINT_EVERY) % HISTORY_CHECKPOINT_NUM;
+    memcpy(checkpointState(history, history->current), history->state, boardSize(&history->board));
+    history->checkpointAt[slot] = history->current;
+}
+
+static bool movable(History* history, int from, int to, int count){
+    // `count` units can go from the top of `from` onto `to`
+    const Board* board = &history->board;
+    return tubeLevel(history->state+from*board->capacity, board->capacity) >= count &&
+           tubeLevel(history->state+to*board->capacity, board->capacity)+count <= board->capacity;
+}
+
+static void redoMove(History* history, long long position){
+    HistoryMove m = history->moves[position % HISTORY_MOVE_NUM];
+    boardUnpour(&history->board, history->state, (Move){ m.to, m.from, m.count });
+}
+
+static void undoMove(History* history, long long position){
+    HistoryMove m = history->moves[position % HISTORY_MOVE_NUM];
+    boardUnpour(&history->board, history->state, (Move){ m.from, m.to, m.count });
+}
+
+History* newHistory(const Tubes* tubes){
+    // tubes must be still, the level start becomes position 0
+    Board board;
+    unsigned char* state = boardFromTubes(&board, tubes);
+    History* history = newHistoryFromBoard(&board, state);
+    free(state);
+    return history;
+}
+
+History* newHistoryFromBoard(const Board* board, const unsigned char* state){
+    if(board->tubeNum > UINT16_MAX){
+        printf("Error: too many tubes for the undo history\n");
+        exit(-1);
+    }
+    History* history = calloc(1, sizeof(History));
+    history->board = *board;
+    history->state = malloc(boardSize(board));
+    memcpy(history->state, state, boardSize(board));
+    history->moves = malloc(sizeof(HistoryMove)*HISTORY_MOVE_NUM);
+    history->checkpoints = malloc((size_t)HISTORY_CHECKPOINT_NUM*boardSize(&history->board));
+    history->checkpointAt = malloc(sizeof(long long)*HISTORY_CHECKPOINT_NUM);
+    for(int i = 0; i < HISTORY_CHECKPOINT_NUM; i++) history->checkpointAt[i] = -1;
+    saveCheckpoint(history);
+    return history;
+}
+
+void freeHistory(History* history){
+    free(history->checkpointAt);
+    free(history->checkpoints);
+    free(history->moves);
+    free(history->state);
+    free(history);
+}
+
+void historyPush(History* history, int from, int to, int count){
+    // record a pour the moment it starts, the redo list is dropped. a pour the
+    // history board cannot take is an error of the caller and is not recorded
+    if(count <= 0 || !movable(history, from, to, count)){
+        printf("Error: pour of %d from tube %d to %d does not fit the undo history\n", count, from, to);
+        return;
+    }
+    history->moves[history->current % HISTORY_MOVE_NUM] = (HistoryMove){ from, to, count };
+    redoMove(history, history->current);
+    history->last = ++history->current;
+    if(history->last-history->first > HISTORY_MOVE_NUM) history->first++;
+    if(history->current % HISTORY_CHECKPOINT_EVERY == 0) saveCheckpoint(history);
+}
+
+bool historyRebuild(History* history){
+    // snapshots of every kept position after moves, first, current and last were set
+    // directly; false if a kept pour does not fit the board it is replayed on
+    int size = boardSize(&history->board);
+    unsigned char* saved = malloc(size);
+    long long current = history->current;
+    bool ok = true;
+    for(int i = 0; i < HISTORY_CHECKPOINT_NUM; i++) history->checkpointAt[i] = -1;
+    memcpy(saved, history->state, size);
+    while(ok){
+        if(history->current % HISTORY_CHECKPOINT_EVERY == 0) saveCheckpoint(history);
+        if(history->current == history->first) break;
+        HistoryMove m = history->moves[(history->current-1) % HISTORY_MOVE_NUM];
+        ok = movable(history, m.to, m.from, m.count);
+        if(ok) undoMove(history, --history->current);
+    }
+    memcpy(history->state, saved, size);
+    for(history->current = current; ok && history->current < history->last; ){
+        HistoryMove m = history->moves[history->current % HISTORY_MOVE_NUM];
+        ok = movable(history, m.from, m.to, m.count);
+        if(!ok) break;
+        redoMove(history, history->current++);
+        if(history->current % HISTORY_CHECKPOINT_EVERY == 0) saveCheckpoint(history);
+    }
+    memcpy(history->state, saved, size);
+    history->current = current;
+    free(saved);
+    return ok;
+}
+
+bool historyJump(History* history, Tubes* tubes, long long target){
+    // land on `target` at once: animations are finished first, then the board is
+    // rebuilt from the closest of the current position and the snapshot below target
+    target = max(history->first, min(history->last, target));
+    if(target == history->current) return false;
+    settleTubes(tubes);
+    long long base = target-target%HISTORY_CHECKPOINT_EVERY;
+    int slot = (base/HISTORY_CHECKPOINT_EVERY) % HISTORY_CHECKPOINT_NUM;
+    long long distance = history->current > target ? history->current-target : target-history->current;
+    if(base >= history->first && history->checkpointAt[slot] == base && target-base < distance){
+        memcpy(history->state, checkpointState(history, base), boardSize(&history->board));
+        history->current = base;
+    }
+    while(history->current > target) undoMove(history, --history->current);
+    while(history->current < target) redoMove(history, history->current++);
+    boardToTubes(&history->board, history->state, tubes);
+    return true;
+}
+
+bool historyUndo(History* history, Tubes* tubes, int n){
+    return historyJump(history, tubes, history->current-n);
+}
+
+bool historyRedo(History* history, Tubes* tubes, int n){
+    return historyJump(history, tubes, history->current+n);
+}
@@ -0,0 +1,42 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "board.h"
+
+#define HISTORY_MOVE_NUM            65536   // pours kept for undo, older ones are dropped
+#define HISTORY_CHECKPOINT_EVERY    256     // pours between two board snapshots
+#define HISTORY_CHECKPOINT_NUM      (HISTORY_MOVE_NUM/HISTORY_CHECKPOINT_EVERY+1)
+#define HISTORY_REWIND              10      // pours undone by shift+U
+
+// one recorded pour, replayed forward or backward on the packed board.
+// 6 bytes with the padding byte, also the size of a pour in save files (SAVE_MOVE_SIZE)
+typedef struct HistoryMove {
+    uint16_t from;
+    uint16_t to;
+    uint8_t count;
+    uint8_t reserved;
+} HistoryMove;
+
+// undo/redo over a fixed budget: a ring of pours plus a snapshot every
+// HISTORY_CHECKPOINT_EVERY pours, positions count pours from the level start
+typedef struct History {
+    Board board;                // packed level, the palette is fixed at level load
+    unsigned char* state;       // board at `current`, ahead of the tubes while pours animate
+    HistoryMove* moves;         // ring, move p (from position p to p+1) at p % HISTORY_MOVE_NUM
+    unsigned char* checkpoints; // ring of boards at positions multiple of HISTORY_CHECKPOINT_EVERY
+    long long* checkpointAt;    // position of each snapshot, -1 if none
+    long long first;            // oldest position still reachable
+    long long current;
+    long long last;             // end of the redo list
+} History;
+
+History* newHistory(const Tubes* tubes);
+History* newHistoryFromBoard(const Board* board, const unsigned char* state);
+bool historyRebuild(History* history);
+void freeHistory(History* history);
+void historyPush(History* history, int from, int to, int count);
+bool historyJump(History* history, Tubes* tubes, long long target);
+bool historyUndo(History* history, Tubes* tubes, int n);
+bool historyRedo(History* history, Tubes* tubes, int n);
+
+#endif // HISTORY_H
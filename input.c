@@ -0,0 +1,82 @@
+#include <stdlib.h>
+#include <string.h>
+#include "input.h"
+
+static InputEvent liveInput(int frame){
+    InputEvent event = { frame, 0, 0, 0, 0 };
+    if(IsMouseButtonPressed(MOUSE_LEFT_BUTTON)){
+        Vector2 pos = GetMousePosition();
+        event.flags |= INPUT_PRESS;
+        event.x = (int16_t)pos.x;
+        event.y = (int16_t)pos.y;
+    }
+    if(IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) event.flags |= INPUT_RELEASE;
+    if(IsKeyPressed(KEY_H)) event.flags |= INPUT_HINT;
+    if(IsKeyPressed(KEY_U)){
+        event.flags |= INPUT_UNDO;
+        if(IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT)) event.flags |= INPUT_REWIND;
+    }
+    if(IsKeyPressed(KEY_R)) event.flags |= INPUT_REDO;
+    if(IsWindowResized()){
+        // clicks are only replayed right on the same layout. x and y are taken,
+        // a press in the same frame (the mouse is on the window border) is dropped
+        event.flags = (event.flags & ~INPUT_PRESS) | INPUT_RESIZE;
+        event.x = GetScreenWidth();
+        event.y = GetScreenHeight();
+    }
+    if(WindowShouldClose()) event.flags |= INPUT_QUIT;
+    return event;
+}
+
+InputLog* inputRecord(const char* path, const char* level){
+    // level is the level text the game was started with, NULL for the built-in level
+    InputLog* log = calloc(1, sizeof(InputLog));
+    log->file = fopen(path, "wb");
+    if(!log->file){
+        printf("Error: cannot open %s\n", path);
+        exit(-1);
+    }
+    if(level) snprintf(log->level, INPUT_LEVEL_LENGTH, "%s", level);
+    uint32_t header[3] = { INPUT_MAGIC, INPUT_VERSION, strlen(log->level) };
+    fwrite(header, sizeof(header), 1, log->file);
+    fwrite(log->level, 1, header[2], log->file);
+    return log;
+}
+
+InputLog* inputReplay(const char* path){
+    InputLog* log = calloc(1, sizeof(InputLog));
+    log->replay = true;
+    log->file = fopen(path, "rb");
+    uint32_t header[3];
+    if(!log->file || fread(header, sizeof(header), 1, log->file) != 1 || header[0] != INPUT_MAGIC ||
+       header[1] != INPUT_VERSION || header[2] >= INPUT_LEVEL_LENGTH ||
+       fread(log->level, 1, header[2], log->file) != header[2]){
+        printf("Error: cannot read input log %s\n", path);
+        exit(-1);
+    }
+    log->pending = fread(&log->next, sizeof(InputEvent), 1, log->file) == 1;
+    return log;
+}
+
+void inputClose(InputLog* log){
+    if(!log) return;
+    fclose(log->file);
+    free(log);
+}
+
+InputEvent inputPoll(InputLog* log, int frame){
+    // live input, written to the log when recording; read from the log when replaying,
+    // a replay quits once its log runs out
+    if(log && log->replay){
+        InputEvent event = { frame, 0, 0, 0, 0 };
+        if(!log->pending) event.flags = INPUT_QUIT;
+        else if(log->next.frame <= (uint32_t)frame){
+            event = log->next;
+            log->pending = fread(&log->next, sizeof(InputEvent), 1, log->file) == 1;
+        }
+        return event;
+    }
+    InputEvent event = liveInput(frame);
+    if(log && event.flags) fwrite(&event, sizeof(InputEvent), 1, log->file);
+    return event;
+}
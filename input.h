@@ -0,0 +1,47 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "raylib.h"
+
+#define INPUT_MAGIC         0x4E495357u // "WSIN"
+#define INPUT_VERSION       1
+#define INPUT_LEVEL_LENGTH  4096
+
+// what the game loop reads in one frame
+#define INPUT_PRESS         1   // left mouse button pressed at (x, y)
+#define INPUT_RELEASE       2   // left mouse button released
+#define INPUT_HINT          4   // H
+#define INPUT_UNDO          8   // U
+#define INPUT_REWIND        16  // shift held with U
+#define INPUT_REDO          32  // R
+#define INPUT_QUIT          64  // window closed, last event of a log
+#define INPUT_RESIZE        128 // window resized to (x, y)
+
+// one frame with input, frames without any are not logged
+typedef struct InputEvent {
+    uint32_t frame;
+    uint16_t flags;
+    int16_t x;
+    int16_t y;
+    uint16_t reserved;
+} InputEvent;
+
+// input log file: magic, version, length of the level text, the level text
+// ("" for the built-in level) and then InputEvents in frame order
+typedef struct InputLog {
+    FILE* file;
+    bool replay;
+    bool pending;       // `next` holds an event read ahead in replay
+    InputEvent next;
+    char level[INPUT_LEVEL_LENGTH];
+} InputLog;
+
+InputLog* inputRecord(const char* path, const char* level);
+InputLog* inputReplay(const char* path);
+void inputClose(InputLog* log);
+InputEvent inputPoll(InputLog* log, int frame);
+
+#endif // INPUT_H
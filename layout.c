@@ -0,0 +1,63 @@
+#include "layout.h"
+
+Layout layout = { 0 };
+
+Layout computeLayout(int tubeNum, int width, int height){
+    // tries every column count and keeps the largest scale, ties go to fewer rows
+    Layout best = { tubeNum, width, height, 1, tubeNum, 0.0, 0.0, 0.0 };
+    for(int cols = tubeNum; cols >= 1; cols--){
+        int rows = (tubeNum+cols-1)/cols;
+        float scale = min(width/((cols+2)*LAYOUT_SLOT_WIDTH), height/(rows*LAYOUT_SLOT_HEIGHT+LAYOUT_BOTTOM));
+        if(scale > best.scale){
+            best.cols = cols;
+            best.rows = rows;
+            best.scale = scale;
+        }
+    }
+    best.scale = min(best.scale, LAYOUT_MAX_SCALE);
+    best.originX = (width-best.cols*LAYOUT_SLOT_WIDTH*best.scale)/2;
+    best.originY = (height-(best.rows*LAYOUT_SLOT_HEIGHT+LAYOUT_BOTTOM)*best.scale)/2+(LAYOUT_SLOT_HEIGHT-LAYOUT_TUBE_HEIGHT)*best.scale;
+    return best;
+}
+
+void updateLayout(void){
+    // recomputed only when the window or the tube count changed. tube sizes and
+    // animation distances are globals shared by every tube
+    if(layout.tubeNum == TUBE_NUM && layout.width == screenWidth && layout.height == screenHeight) return;
+    if(screenWidth <= 0 || screenHeight <= 0) return; // minimized, keep the last layout
+    layout = computeLayout(TUBE_NUM, screenWidth, screenHeight);
+    TUBE_WIDTH = LAYOUT_TUBE_WIDTH*layout.scale;
+    TUBE_HEIGHT = LAYOUT_TUBE_HEIGHT*layout.scale;
+    TUBE_THICKNESS = max(1, (int)(5*layout.scale+0.5));
+    HEIGHT_SELECT = 15.0*layout.scale;
+    HEIGHT_POUR = 15.0*layout.scale;
+}
+
+Rectangle layoutTube(int idx){
+    // still position of tube idx in a window of screenWidth x screenHeight
+    updateLayout();
+    int row = idx/layout.cols, col = idx%layout.cols;
+    int rowTubes = min(layout.cols, TUBE_NUM-row*layout.cols);
+    float slotWidth = LAYOUT_SLOT_WIDTH*layout.scale;
+    return (Rectangle){ layout.originX+(col+(layout.cols-rowTubes)/2.0)*slotWidth,
+                        layout.originY+row*LAYOUT_SLOT_HEIGHT*layout.scale, TUBE_WIDTH, TUBE_HEIGHT };
+}
+
+bool relayoutTubes(Tubes* tubes, int width, int height){
+    // on a window resize: animations finish at once, the tubes move to the new layout
+    // and the selected tube is lifted again. false if the layout did not change.
+    // a minimized window (0 wide or high) keeps the current layout
+    if(width <= 0 || height <= 0) return false;
+    screenWidth = width;
+    screenHeight = height;
+    if(layout.tubeNum == TUBE_NUM && layout.width == width && layout.height == height) return false;
+    int selected = selectedTube;
+    settleTubes(tubes);
+    for(int i = 0; i < TUBE_NUM; i++) tubes->rect[i] = layoutTube(i);
+    indexTubes(tubes, width, height);
+    if(selected != -1){
+        selectTube(tubes, selected);
+        advanceTubes(tubes, MAX_FRAME_NUM);
+    }
+    return true;
+}
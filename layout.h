@@ -0,0 +1,36 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stdbool.h>
+#include "raylib.h"
+#include "utils.h"
+
+// sizes at scale 1, where 5 tubes fill the default 700x600 window
+#define LAYOUT_TUBE_WIDTH       80.0
+#define LAYOUT_TUBE_HEIGHT      300.0
+#define LAYOUT_SLOT_WIDTH       100.0   // one tube and the gap to the next
+#define LAYOUT_SLOT_HEIGHT      450.0   // one tube and the room above it for lifting and pouring
+#define LAYOUT_BOTTOM           150.0   // below the last row, the sides get one slot each
+#define LAYOUT_MAX_SCALE        2.0
+#define LAYOUT_START_WIDTH      1600    // widest window opened at start
+
+// tubes in rows, as large as the window allows; the last row is centered
+typedef struct Layout {
+    int tubeNum;
+    int width;          // window the layout was computed for
+    int height;
+    int cols;
+    int rows;
+    float scale;
+    float originX;      // top left of the first tube
+    float originY;
+} Layout;
+
+extern Layout layout;
+
+Layout computeLayout(int tubeNum, int width, int height);
+void updateLayout(void);
+Rectangle layoutTube(int idx);
+bool relayoutTubes(Tubes* tubes, int width, int height);
+
+#endif // LAYOUT_H
@@ -1,88 +1,352 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "raylib.h"
 #include "utils.h"
+#include "solver.h"
+#include "cache.h"
+#include "history.h"
+#include "save.h"
+#include "input.h"
+#include "layout.h"
+#include "resolution.h"
+#include "asset.h"
+#include "trace.h"
 
-int main(void){
+SolutionCache* solutionCache;
+
+void printHint(Tubes* tubes){
+    // search from the current still board and print the next pour
+    Board board;
+    unsigned char* state = boardFromTubes(&board, tubes);
+    Solution solution = cachedSearch(solutionCache, &board, state, BEAM_WIDTH, BEAM_MAX_DEPTH, 0);
+    if(!solution.solved) printf("Hint: no solution found\n");
+    else if(solution.moveNum > 0)
+        printf("Hint: pour tube %d into tube %d (%d moves left)\n",
+               solution.moves[0].from, solution.moves[0].to, solution.moveNum);
+    freeSolution(&solution);
+    free(state);
+}
+
+Tubes* loadLevel(const char* text){
+    // level text as in boardParse, e.g. "6:aaabbb,bbbaaa,,", replaces the built-in level
+    Board board;
+    unsigned char* state = boardParse(&board, text);
+    if(!state){
+        printf("Error: bad level %s\n", text);
+        exit(-1);
+    }
+    Tubes* tubes = boardNewTubes(&board, state);
+    free(state);
+    return tubes;
+}
+
+int clickedTube = -1;
+Vector2 mousePos;
+
+bool handleInput(Tubes* tubes, History* history, InputEvent input){
+    // game logic of one frame's input, true if the game state changed
+    bool changed = false;
+    if(input.flags & INPUT_PRESS){
+        mousePos = (Vector2){ input.x, input.y };
+        int i = tubeAt(tubes, mousePos);
+        if(i != -1){
+            clickedTube = i;
+            // printf("Pressed tube: %d\n", i);
+        }
+    }
+    if(input.flags & INPUT_RELEASE){
+        if(clickedTube != -1){
+            if(insideTube(mousePos, tubes->rect[clickedTube], tubes->angle[clickedTube])){
+                changed = true;
+                printf("Clicked tube: %d\n", clickedTube);
+                if(selectedTube == -1){
+                    if(countWater(tubes->contains[clickedTube]) > 0){
+                        if(tubes->animationStage[clickedTube] == STILL && !pouredTo(tubes, clickedTube)){
+                            printf("Selected tube: %d\n", clickedTube);
+                            selectTube(tubes, clickedTube);
+                        }
+                    }
+                } else if(selectedTube == clickedTube){ // clicked selected tube
+                    printf("Deselected tube: %d\n", selectedTube);
+                    deselectTube(tubes, selectedTube);
+                    selectedTube = -1;
+                } else { // clicked other tubes
+                    // if(checkPour(tubes, selectedTube, clickedTube) && !pouredTo(tubes, clickedTube)){
+                    if(checkPour(tubes, selectedTube, clickedTube)){
+                        historyPush(history, selectedTube, clickedTube, pour(tubes, selectedTube, clickedTube));
+                    }
+                    else {
+                        deselectTube(tubes, selectedTube);
+                    }
+                    selectedTube = -1;
+                }
+            }
+        }
+        clickedTube = -1;
+    }
+    if(input.flags & INPUT_HINT && selectedTube == -1){
+        bool still = true;
+        for(int i = 0; i < TUBE_NUM; i++)
+            if(animationIdx[i] > 0) still = false;
+        if(still) printHint(tubes);
+    }
+    if(input.flags & INPUT_UNDO)
+        changed |= historyUndo(history, tubes, input.flags & INPUT_REWIND ? HISTORY_REWIND : 1);
+    if(input.flags & INPUT_REDO) changed |= historyRedo(history, tubes, 1);
+    return changed;
+}
+
+int compareTime(const void* a, const void* b){
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y)-(x < y);
+}
+
+void printFrameTimes(double* times, int frameNum){
+    // frame time distribution of a recorded or replayed run
+    if(frameNum == 0) return;
+    double total = 0;
+    for(int i = 0; i < frameNum; i++) total += times[i];
+    qsort(times, frameNum, sizeof(double), compareTime);
+    printf("Frames: %d, mean %.3f ms, p50 %.3f ms, p95 %.3f ms, p99 %.3f ms, max %.3f ms\n", frameNum,
+           total/frameNum*1e3, times[frameNum/2]*1e3, times[frameNum*95/100]*1e3, times[frameNum*99/100]*1e3,
+           times[frameNum-1]*1e3);
+}
+
+double wallTime(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec+t.tv_nsec*1e-9;
+}
+
+double processAge(void){
+    // seconds since the process was started by the kernel (starttime, field 22 of /proc/self/stat,
+    // in clock ticks since boot), -1 if unknown. counts the loader and library setup before main
+    FILE* file = fopen("/proc/self/stat", "r");
+    if(!file) return -1;
+    char line[1024];
+    bool read = fgets(line, sizeof(line), file) != NULL;
+    fclose(file);
+    char* p = read ? strrchr(line, ')') : NULL; // the name in field 2 may hold spaces
+    unsigned long long ticks;
+    if(!p || sscanf(p+1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %*d %*d %*d %llu", &ticks) != 1)
+        return -1;
+    struct timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    return now.tv_sec+now.tv_nsec*1e-9-(double)ticks/sysconf(_SC_CLK_TCK);
+}
+
+void runHeadless(Tubes* tubes, History* history, InputLog* inputLog, bool skip){
+    // replays the log on the simulation clock alone: no window, no drawing, no frame pacing.
+    // with skip the frames between two logged events are advanced in one step
+    double begin = wallTime();
+    while(1){
+        InputEvent input = inputPoll(inputLog, frame);
+        if(input.flags & INPUT_QUIT) break;
+        if(input.flags & INPUT_RESIZE) relayoutTubes(tubes, input.x, input.y);
+        if(!gameEnd(tubes)){
+            handleInput(tubes, history, input);
+            updateTubes(tubes);
+        }
+        ++frame;
+        if(skip && inputLog->pending && inputLog->next.frame > (uint32_t)frame){
+            int frameNum = inputLog->next.frame-frame;
+            advanceTubes(tubes, frameNum);
+            frame += frameNum;
+        }
+    }
+    double seconds = wallTime()-begin;
+    printf("Headless replay: %d frames (%.1f s at 60 fps) in %.3f ms, %.0fx real time\n", frame, frame/60.0,
+           seconds*1e3, frame/60.0/max(seconds, 1e-9));
+    // the tubes as drawn, pours land on them in the order their animations end.
+    // the history board numbers its colors differently, so it is compared color by color
+    Board board;
+    unsigned char* state = boardFromTubes(&board, tubes);
+    bool same = true;
+    for(int i = 0; i < TUBE_NUM; i++)
+        for(int j = 0; j < TUBE_CAPACITY; j++)
+            if(!sameColor(tubes->contains[i][j], history->board.palette[history->state[i*TUBE_CAPACITY+j]])) same = false;
+    printf("Pours: %lld, solved: %s, tubes hash: %016llx, history %s the tubes\n", history->current,
+           gameEnd(tubes) ? "yes" : "no", (unsigned long long)boardHash(&board, state), same ? "matches" : "differs from");
+    free(state);
+}
+
+int main(int argc, char** argv){
+    double startTime = wallTime();
+    //   ./main [level] [-record input.log | -replay input.log [-headless [-skip]]] [-budget ms] [-startup] [-trace trace.json]
+    // a level given on the command line starts over, otherwise the last game is resumed.
+    // recording and replaying start from the given or built-in level and leave the save alone,
+    // a replay runs the logged input at full speed and prints frame times,
+    // a headless replay skips the window and prints the outcome and simulation speed.
+    // with a frame time budget the scene is drawn at a lower resolution while tubes move and frames are slow.
+    // -startup prints the time from process start and from main to the first presented frame and quits.
+    // -trace writes frame phases, tube animations, solver jobs and asset loads as Chrome trace events,
+    // it needs a build with tracing: make -B TRACE=1
+    const char* level = NULL;
+    const char* recordPath = NULL;
+    const char* replayPath = NULL;
+    bool headless = false, skip = false;
+    float budget = 0;
+    bool startup = false;
+    const char* tracePath = NULL;
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "-record") == 0 && i+1 < argc) recordPath = argv[++i];
+        else if(strcmp(argv[i], "-replay") == 0 && i+1 < argc) replayPath = argv[++i];
+        else if(strcmp(argv[i], "-headless") == 0) headless = true;
+        else if(strcmp(argv[i], "-skip") == 0) skip = true;
+        else if(strcmp(argv[i], "-budget") == 0 && i+1 < argc) budget = atof(argv[++i]);
+        else if(strcmp(argv[i], "-startup") == 0) startup = true;
+        else if(strcmp(argv[i], "-trace") == 0 && i+1 < argc) tracePath = argv[++i];
+        else level = argv[i];
+    }
+    if((headless && !replayPath) || (skip && !headless)){
+        printf("Error: -headless needs -replay, -skip needs -headless\n");
+        exit(-1);
+    }
+    if(tracePath){
+#ifdef WATERSORT_TRACE
+        traceOpen(tracePath);
+#else
+        printf("Error: -trace needs a build with tracing, make -B TRACE=1\n");
+        exit(-1);
+#endif
+    }
+    InputLog* inputLog = NULL;
+    if(replayPath){
+        inputLog = inputReplay(replayPath);
+        level = inputLog->level[0] ? inputLog->level : NULL;
+    } else if(recordPath) inputLog = inputRecord(recordPath, level);
+
+    Tubes* tubes;
+    History* history = NULL;
+    if(level) tubes = loadLevel(level);
+    else if(inputLog || !loadGameFile(SAVE_FILE, &tubes, &history)){
+        tubes = newTubes(TUBE_NUM);
+        initGame(tubes);
+    }
+    // wide enough for one row if the screen allows, larger boards take more rows
+    relayoutTubes(tubes, min(max(screenWidth, LAYOUT_SLOT_WIDTH*(TUBE_NUM+2)), LAYOUT_START_WIDTH), screenHeight);
+    if(headless){
+        solutionCache = cacheOpen(CACHE_FILE);
+        history = newHistory(tubes);
+        runHeadless(tubes, history, inputLog, skip);
+        inputClose(inputLog);
+        freeHistory(history);
+        cacheClose(solutionCache);
+        freeTubes(tubes);
+        return 0;
+    }
+    SetConfigFlags(FLAG_WINDOW_RESIZABLE);
     InitWindow(screenWidth, screenHeight, "Watersort");
-    SetTargetFPS(60);
-    Tube* tubes = malloc(TUBE_NUM * sizeof(Tube));
-    initGame(tubes);
-    Texture2D backgroundImage = LoadTexture("assets/background.png");
+    // frames are paced by the loop instead of SetTargetFPS, so the wait is known and
+    // left out of the work time the resolution controller sees
+    SetTargetFPS(0);
+    double frameTarget = inputLog && inputLog->replay ? 0 : 1.0/60;
+    Texture2D backgroundImage = loadAssetTexture("background", "assets/background.png");
+    Resolution* resolution = budget > 0 ? newResolution(budget/1000.0) : NULL;
+    solutionCache = cacheOpen(CACHE_FILE);
+    if(!history) history = newHistory(tubes);
 
-    int keyPressed = 0, clickedTube = -1;
-    Vector2 mousePos;
+    int keyPressed = 0;
+    bool changed = false, focused = true, won = false;
+    double* frameTimes = NULL;
+    int frameTimeCap = 0;
+    double workTime = 0; // last frame including the buffer swap, without the pacing wait
 
-    while (!WindowShouldClose()){
-        if(GetScreenWidth() > screenWidth || GetScreenHeight() > screenHeight) {
-            SetWindowSize(screenWidth, screenHeight);
+    while (1){
+        double frameBegin = GetTime();
+        TRACE_BEGIN("frame");
+        TRACE_BEGIN("input");
+        InputEvent input = inputPoll(inputLog, frame);
+        if(input.flags & INPUT_QUIT){
+            TRACE_END("input");
+            TRACE_END("frame");
+            break;
         }
+        if(input.flags & INPUT_RESIZE) relayoutTubes(tubes, input.x, input.y);
         // printf("current frame: %d\n", frame);
         // printf("%d: Mouse positions at (%lf, %lf)!", ++frame, mouse_pos.x, mouse_pos.y);
         // TraceLog(LOG_INFO, "%d: Mouse positions at (%lf, %lf)!", ++frame, mouse_pos.x, mouse_pos.y);
         // printf("%d\n", gameEnd(tubes));
         if(!gameEnd(tubes)){
-            if(IsMouseButtonPressed(MOUSE_LEFT_BUTTON)){
-                mousePos = GetMousePosition();
-                for(int i = 0; i < TUBE_NUM; i++)
-                    if(insideTube(mousePos, tubes[i])){
-                        clickedTube = i;
-                        // printf("Pressed tube: %d\n", i);
-                    }
-            }
-            if(IsMouseButtonReleased(MOUSE_LEFT_BUTTON)){
-                if(clickedTube != -1){
-                    if(insideTube(mousePos, tubes[clickedTube])){
-                        printf("Clicked tube: %d\n", clickedTube);
-                        if(selectedTube == -1){
-                            if(countWater(tubes[clickedTube]) > 0){
-                                if(tubes[clickedTube].animationStage == STILL && !pouredTo(tubes, clickedTube)){
-                                    printf("Selected tube: %d\n", clickedTube);
-                                    selectTube(tubes, clickedTube);
-                                }
-                            }
-                        } else if(selectedTube == clickedTube){ // clicked selected tube
-                            printf("Deselected tube: %d\n", selectedTube);
-                            deselectTube(tubes, selectedTube);
-                            selectedTube = -1;
-                        } else { // clicked other tubes
-                            // if(checkPour(tubes, selectedTube, clickedTube) && !pouredTo(tubes, clickedTube)){
-                            if(checkPour(tubes, selectedTube, clickedTube)){
-                                pour(tubes, selectedTube, clickedTube);
-                            }
-                            else {
-                                deselectTube(tubes, selectedTube);
-                            }
-                            selectedTube = -1;
-                        }
-                    }
-                }
-                clickedTube = -1;
+            changed = handleInput(tubes, history, input);
+            TRACE_END("input");
+            // snapshot after every change and when the window loses focus
+            if(!inputLog && (changed || (focused && !IsWindowFocused()))){
+                TRACE_BEGIN("save");
+                saveGameFile(SAVE_FILE, history);
+                TRACE_END("save");
             }
+            changed = false;
+            focused = IsWindowFocused();
+            TRACE_BEGIN("update");
             updateTubes(tubes);
+            TRACE_END("update");
 
-            BeginDrawing();
+            if(resolution){
+                bool idle = true;
+                for(int i = 0; i < TUBE_NUM; i++)
+                    if(animationIdx[i] > 0) idle = false;
+                resolutionUpdate(resolution, workTime, idle);
+            }
+            TRACE_BEGIN("draw");
+            beginScene(resolution);
             ClearBackground(BACKGROUND_COLOR);
             DrawTexture(backgroundImage, 0, 0, WHITE);
-            DrawText("Click on tubes to select!", 250, 500, 20, TUBE_WALL_COLOR);
+            DrawText("Click on tubes to select!", 250, screenHeight-100, 20, TUBE_WALL_COLOR);
             // DrawText("Congrats! You created your first window!", 190, 200, 20, BACKGROUND_COLOR);
             drawTubes(tubes);
-            EndDrawing();
+            TRACE_BEGIN("present");
+            endScene(resolution);
+            TRACE_END("present");
+            TRACE_END("draw");
         } else {
-            BeginDrawing();
+            TRACE_END("input");
+            if(!won && !inputLog) remove(SAVE_FILE);
+            won = true;
+            if(resolution) resolutionUpdate(resolution, workTime, true);
+            beginScene(resolution);
             ClearBackground(BACKGROUND_COLOR);
             DrawTexture(backgroundImage, 0, 0, WHITE);
             DrawText("You win!", 190, 200, 80, TUBE_WALL_COLOR);
             // drawTubes(tubes);
-            EndDrawing();
+            endScene(resolution);
+        }
+        workTime = GetTime()-frameBegin;
+        if(workTime < frameTarget) WaitTime(frameTarget-workTime);
+        if(inputLog && inputLog->replay){
+            if(frame == frameTimeCap){
+                frameTimeCap = max(2*frameTimeCap, 1024);
+                frameTimes = realloc(frameTimes, sizeof(double)*frameTimeCap);
+            }
+            frameTimes[frame] = GetTime()-frameBegin;
+        }
+        TRACE_END("frame");
+        if(startup){
+            double age = processAge();
+            if(age >= 0) printf("Startup: %.0f ms from process start to the first frame (%.1f ms from main)\n", age*1e3,
+                                (wallTime()-startTime)*1e3);
+            else printf("Startup: %.1f ms from main to the first frame\n", (wallTime()-startTime)*1e3);
+            break;
         }
         ++frame;
         
         // printf("clicking tube: %d\n", clickedTube);
         // printf("selected tube: %d\n", selectedTube);
     }
+    if(inputLog){
+        if(inputLog->replay) printFrameTimes(frameTimes, frame);
+        free(frameTimes);
+        inputClose(inputLog);
+    } else if(!gameEnd(tubes)) saveGameFile(SAVE_FILE, history);
+    freeHistory(history);
+    cacheClose(solutionCache);
+    freeTubes(tubes);
+    freeResolution(resolution);
     CloseWindow();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,213 @@
+#ifdef WATERSORT_PERF
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perfcount.h"
+
+#define PERF_COUNTER_NUM    4
+#define PERF_TIME           PERF_COUNTER_NUM // value slot of the wall time in ns
+
+static const char* const COUNTER_NAMES[PERF_COUNTER_NUM] = { "cycles", "instructions", "cache misses", "branch misses" };
+static const uint64_t COUNTER_CONFIGS[PERF_COUNTER_NUM] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+};
+static const char* const REGION_NAMES[PERF_REGION_NUM] = { "pour", "moves", "prune", "hash", "water" };
+
+// measured calls of one region, summed
+typedef struct PerfSums {
+    long long calls;
+    long long measured;
+    uint64_t value[PERF_COUNTER_NUM+1];
+} PerfSums;
+
+// counters are per thread: opened when a thread enters its first region, closed when it ends
+typedef struct PerfThread {
+    int fd[PERF_COUNTER_NUM];                               // -1 if the counter could not be opened
+    struct perf_event_mmap_page* page[PERF_COUNTER_NUM];    // NULL if the counter is only read()
+    uint64_t start[PERF_REGION_NUM][PERF_COUNTER_NUM+1];
+    bool measuring[PERF_REGION_NUM];
+    int untilSample[PERF_REGION_NUM];                       // calls left before the next measured one
+    PerfSums sums[PERF_REGION_NUM];
+    struct PerfThread* next;
+} PerfThread;
+
+static pthread_mutex_t perfLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t perfOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t perfKey;
+static PerfThread* liveThreads;
+static PerfSums endedSums[PERF_REGION_NUM];
+static int counterError[PERF_COUNTER_NUM];  // errno of a failed open, later threads do not retry
+static __thread PerfThread* self;
+
+static uint64_t nowNs(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec*1000000000ULL+now.tv_nsec;
+}
+
+static uint64_t readCounter(const PerfThread* t, int k){
+    // rdpmc straight from user space when the kernel allows it, a read() otherwise
+#if defined(__x86_64__) || defined(__i386__)
+    volatile struct perf_event_mmap_page* pc = t->page[k];
+    if(pc){
+        uint32_t seq;
+        uint64_t count;
+        bool direct;
+        do {
+            seq = pc->lock;
+            __atomic_signal_fence(__ATOMIC_SEQ_CST);
+            uint32_t idx = pc->index;
+            count = pc->offset;
+            direct = pc->cap_user_rdpmc && idx;
+            if(direct){
+                uint32_t lo, hi;
+                int width = pc->pmc_width;
+                __asm__ volatile("rdpmc" : "=a"(lo), "=d"(hi) : "c"(idx-1));
+                int64_t pmc = (int64_t)(((uint64_t)hi << 32 | lo) << (64-width));
+                count += pmc >> (64-width);
+            }
+            __atomic_signal_fence(__ATOMIC_SEQ_CST);
+        } while(pc->lock != seq);
+        if(direct) return count;
+    }
+#endif
+    uint64_t value = 0;
+    if(read(t->fd[k], &value, sizeof(value)) != sizeof(value)) return 0;
+    return value;
+}
+
+static void addSums(PerfSums* to, const PerfSums* from){
+    for(int r = 0; r < PERF_REGION_NUM; r++){
+        to[r].calls += from[r].calls;
+        to[r].measured += from[r].measured;
+        for(int k = 0; k <= PERF_COUNTER_NUM; k++) to[r].value[k] += from[r].value[k];
+    }
+}
+
+static void perfThreadEnd(void* arg){
+    PerfThread* t = arg;
+    pthread_mutex_lock(&perfLock);
+    addSums(endedSums, t->sums);
+    PerfThread** p = &liveThreads;
+    while(*p != t) p = &(*p)->next;
+    *p = t->next;
+    pthread_mutex_unlock(&perfLock);
+    for(int k = 0; k < PERF_COUNTER_NUM; k++){
+        if(t->page[k]) munmap(t->page[k], sysconf(_SC_PAGESIZE));
+        if(t->fd[k] >= 0) close(t->fd[k]);
+    }
+    free(t);
+}
+
+static void perfInit(void){
+    pthread_key_create(&perfKey, perfThreadEnd);
+    atexit(perfReport);
+}
+
+static PerfThread* perfThread(void){
+    pthread_once(&perfOnce, perfInit);
+    PerfThread* t = calloc(1, sizeof(PerfThread));
+    // solver threads live for one beam layer: starting every thread at the same call
+    // would measure only its first, cold cache call, so each starts at a random one
+    uint64_t rng = nowNs() ^ (uint64_t)syscall(SYS_gettid) << 32;
+    for(int r = 0; r < PERF_REGION_NUM; r++){
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        t->untilSample[r] = rng % PERF_SAMPLE_EVERY;
+    }
+    for(int k = 0; k < PERF_COUNTER_NUM; k++){
+        t->fd[k] = -1;
+        if(__atomic_load_n(&counterError[k], __ATOMIC_RELAXED)) continue;
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = COUNTER_CONFIGS[k];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        t->fd[k] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if(t->fd[k] < 0){
+            __atomic_store_n(&counterError[k], errno ? errno : EINVAL, __ATOMIC_RELAXED);
+            continue;
+        }
+        void* page = mmap(NULL, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, t->fd[k], 0);
+        t->page[k] = page == MAP_FAILED ? NULL : page;
+    }
+    pthread_mutex_lock(&perfLock);
+    t->next = liveThreads;
+    liveThreads = t;
+    pthread_mutex_unlock(&perfLock);
+    pthread_setspecific(perfKey, t);
+    return t;
+}
+
+void perfBegin(int region){
+    // only every PERF_SAMPLE_EVERY-th call is measured, the others are only counted
+    PerfThread* t = self ? self : (self = perfThread());
+    t->sums[region].calls++;
+    if(t->untilSample[region]-- > 0) return;
+    t->untilSample[region] = PERF_SAMPLE_EVERY-1;
+    t->measuring[region] = true;
+    t->start[region][PERF_TIME] = nowNs();
+    for(int k = 0; k < PERF_COUNTER_NUM; k++)
+        if(t->fd[k] >= 0) t->start[region][k] = readCounter(t, k);
+}
+
+void perfEnd(int region){
+    PerfThread* t = self;
+    if(!t || !t->measuring[region]) return;
+    uint64_t end[PERF_COUNTER_NUM+1];
+    for(int k = PERF_COUNTER_NUM-1; k >= 0; k--)
+        if(t->fd[k] >= 0) end[k] = readCounter(t, k);
+    end[PERF_TIME] = nowNs();
+    PerfSums* sums = &t->sums[region];
+    for(int k = 0; k <= PERF_COUNTER_NUM; k++)
+        if(k == PERF_TIME || t->fd[k] >= 0) sums->value[k] += end[k]-t->start[region][k];
+    sums->measured++;
+    t->measuring[region] = false;
+}
+
+void perfReport(void){
+    // averages per measured call; the total time is the average times all calls
+    PerfSums sums[PERF_REGION_NUM];
+    memset(sums, 0, sizeof(sums));
+    pthread_mutex_lock(&perfLock);
+    addSums(sums, endedSums);
+    for(PerfThread* t = liveThreads; t; t = t->next) addSums(sums, t->sums);
+    pthread_mutex_unlock(&perfLock);
+
+    bool available[PERF_COUNTER_NUM];
+    for(int k = 0; k < PERF_COUNTER_NUM; k++){
+        available[k] = counterError[k] == 0;
+        if(!available[k]) printf("Perf: %s unavailable (%s)\n", COUNTER_NAMES[k], strerror(counterError[k]));
+    }
+    printf("Perf: 1 in %d calls measured from a random first call per thread, per call:\n", PERF_SAMPLE_EVERY);
+    printf("%-6s %12s %10s %10s %10s %10s %6s %12s %13s\n", "region", "calls", "total ms", "ns",
+           "cycles", "instr", "IPC", "cache miss", "branch miss");
+    for(int r = 0; r < PERF_REGION_NUM; r++){
+        if(sums[r].measured == 0) continue;
+        double n = sums[r].measured, ns = sums[r].value[PERF_TIME]/n;
+        char counts[PERF_COUNTER_NUM][32], ipc[32] = "-";
+        for(int k = 0; k < PERF_COUNTER_NUM; k++){
+            if(available[k]) snprintf(counts[k], sizeof(counts[k]), "%.1f", sums[r].value[k]/n);
+            else snprintf(counts[k], sizeof(counts[k]), "-");
+        }
+        if(available[0] && available[1] && sums[r].value[0] > 0)
+            snprintf(ipc, sizeof(ipc), "%.2f", (double)sums[r].value[1]/sums[r].value[0]);
+        printf("%-6s %12lld %10.1f %10.1f %10s %10s %6s %12s %13s\n", REGION_NAMES[r], sums[r].calls,
+               ns*sums[r].calls/1e6, ns, counts[0], counts[1], ipc, counts[2], counts[3]);
+    }
+}
+
+#endif // WATERSORT_PERF
@@ -0,0 +1,35 @@
+#ifndef PERFCOUNT_H
+#define PERFCOUNT_H
+
+// hardware counters (cycles, instructions, cache misses, branch misses) around
+// named regions, built in with -DWATERSORT_PERF (make -B PERF=1). a summary per
+// region is printed at exit; without the define every macro is empty
+
+#define PERF_SAMPLE_EVERY   32  // calls of a region per thread between two measured ones
+
+typedef enum {
+    PERF_POUR       = 0,    // boardPour and boardUnpour
+    PERF_MOVES      = 1,    // boardMoves
+    PERF_PRUNE      = 2,    // pruning rules over the generated moves
+    PERF_HASH       = 3,    // boardHash
+    PERF_WATER      = 4,    // water geometry of one tube
+    PERF_REGION_NUM
+} PerfRegion;
+
+#ifdef WATERSORT_PERF
+
+void perfBegin(int region);
+void perfEnd(int region);
+void perfReport(void);
+
+#define PERF_BEGIN(region)  perfBegin(region)
+#define PERF_END(region)    perfEnd(region)
+
+#else
+
+#define PERF_BEGIN(region)  ((void)0)
+#define PERF_END(region)    ((void)0)
+
+#endif // WATERSORT_PERF
+
+#endif // PERFCOUNT_H
@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "raylib.h"
+#include "utils.h"
+#include "difficulty.h"
+
+#define RATE_LEVEL_NUM      1000
+#define RATE_PRINT_NUM      20      // levels printed one per line
+
+double rateTime(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec+ts.tv_nsec*1e-9;
+}
+
+int main(int argc, char** argv){
+    // rates the built-in level followed by shuffled levels:
+    // ./rate [level count] [colors] [empty tubes]
+    int levelNum = argc > 1 ? atoi(argv[1]) : RATE_LEVEL_NUM;
+    int colorNum = argc > 2 ? atoi(argv[2]) : 3;
+    int emptyNum = argc > 3 ? atoi(argv[3]) : 2;
+    Board* boards = malloc(sizeof(Board)*(levelNum+1));
+    unsigned char** starts = malloc(sizeof(unsigned char*)*(levelNum+1));
+    Difficulty* results = malloc(sizeof(Difficulty)*(levelNum+1));
+
+    Tubes* tubes = newTubes(TUBE_NUM);
+    initTubes(tubes);
+    starts[0] = boardFromTubes(&boards[0], tubes);
+    freeTubes(tubes);
+    for(int i = 1; i <= levelNum; i++)
+        starts[i] = boardRandom(&boards[i], colorNum, emptyNum, TUBE_CAPACITY, i);
+
+    SolutionCache* cache = cacheOpen(CACHE_FILE);
+    double begin = rateTime();
+    rateLevels(cache, boards, starts, levelNum+1, results);
+    double elapsed = rateTime()-begin;
+    cacheClose(cache);
+
+    printf("level  score  length  branching  dead end  solutions  random  states\n");
+    for(int i = 0; i <= levelNum && i < RATE_PRINT_NUM; i++){
+        Difficulty* d = &results[i];
+        if(!d->solvable) printf("%5d  unsolvable%s\n", i, d->exact ? "" : " (state limit)");
+        else printf("%5d  %5.2f  %5d%c  %9.2f  %7.1f%%  %9.0f  %5.1f%%  %6lld\n", i, d->score,
+                    d->optimalLength, d->exact ? ' ' : '+', d->branching, 100*d->deadEndRatio,
+                    d->solutions, 100*d->randomSuccess, d->states);
+    }
+    printf("Rated %d levels in %.3f s (%.0f levels/min, %d threads)\n",
+           levelNum+1, elapsed, (levelNum+1)*60.0/elapsed, solverThreadNum());
+    for(int i = 0; i <= levelNum; i++) free(starts[i]);
+    free(results);
+    free(starts);
+    free(boards);
+    return 0;
+}
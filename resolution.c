@@ -0,0 +1,85 @@
+#include <stdlib.h>
+#include <math.h>
+#include "resolution.h"
+
+Resolution* newResolution(float budget){
+    // needs the window, the target follows its size from the first beginScene
+    Resolution* resolution = calloc(1, sizeof(Resolution));
+    resolution->budget = budget;
+    resolution->scale = 1.0;
+    resolution->ceiling = 2.0;
+    return resolution;
+}
+
+void freeResolution(Resolution* resolution){
+    if(!resolution) return;
+    if(resolution->width > 0) UnloadRenderTexture(resolution->target);
+    free(resolution);
+}
+
+bool resolutionUpdate(Resolution* resolution, float frameTime, bool idle){
+    // called once a frame with the work time of the last frame, true if the scale changed.
+    // idle boards go back to full scale at once. a slow window scales down by the
+    // pixel ratio the budget allows, or back one step right after a step up; a window
+    // without a slow frame steps up, short of any scale already found too slow
+    float scale = resolution->scale;
+    if(idle){
+        resolution->frameNum = 0;
+        resolution->scale = 1.0;
+        resolution->ceiling = 2.0;
+        resolution->raised = false;
+        return scale != 1.0;
+    }
+    if(resolution->frameNum == 0){
+        resolution->frameSum = 0;
+        resolution->frameMax = 0;
+    }
+    resolution->frameSum += frameTime;
+    resolution->frameMax = fmaxf(resolution->frameMax, frameTime);
+    if(++resolution->frameNum < RESOLUTION_WINDOW) return false;
+    resolution->frameNum = 0;
+    float mean = resolution->frameSum/RESOLUTION_WINDOW;
+    if(mean > resolution->budget*RESOLUTION_SLACK){
+        resolution->ceiling = scale;
+        resolution->scale = resolution->raised ? scale-RESOLUTION_STEP
+                                               : fminf(scale*sqrtf(resolution->budget/mean), scale-RESOLUTION_STEP);
+    } else if(resolution->frameMax <= resolution->budget*RESOLUTION_SLACK &&
+              scale+RESOLUTION_STEP < resolution->ceiling-0.001)
+        resolution->scale = scale+RESOLUTION_STEP;
+    resolution->scale = fminf(fmaxf(resolution->scale, RESOLUTION_MIN), 1.0);
+    resolution->raised = resolution->scale > scale;
+    return resolution->scale != scale;
+}
+
+void beginScene(Resolution* resolution){
+    // replaces BeginDrawing, the scene keeps drawing in window coordinates
+    if(!resolution){
+        BeginDrawing();
+        return;
+    }
+    if(resolution->width != GetScreenWidth() || resolution->height != GetScreenHeight()){
+        if(resolution->width > 0) UnloadRenderTexture(resolution->target);
+        resolution->width = GetScreenWidth();
+        resolution->height = GetScreenHeight();
+        resolution->target = LoadRenderTexture(resolution->width, resolution->height);
+        SetTextureFilter(resolution->target.texture, TEXTURE_FILTER_BILINEAR);
+    }
+    BeginTextureMode(resolution->target);
+    BeginMode2D((Camera2D){ (Vector2){ 0, 0 }, (Vector2){ 0, 0 }, 0.0, resolution->scale });
+}
+
+void endScene(Resolution* resolution){
+    // replaces EndDrawing: the scaled part of the target stretched over the window.
+    // render textures are upside down, their top rows are the last ones
+    if(!resolution){
+        EndDrawing();
+        return;
+    }
+    EndMode2D();
+    EndTextureMode();
+    float width = resolution->width*resolution->scale, height = resolution->height*resolution->scale;
+    BeginDrawing();
+    DrawTexturePro(resolution->target.texture, (Rectangle){ 0, resolution->height-height, width, -height },
+                   (Rectangle){ 0, 0, resolution->width, resolution->height }, (Vector2){ 0, 0 }, 0.0, WHITE);
+    EndDrawing();
+}
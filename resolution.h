@@ -0,0 +1,33 @@
+#ifndef RESOLUTION_H
+#define RESOLUTION_H
+
+#include <stdbool.h>
+#include "raylib.h"
+
+#define RESOLUTION_MIN          0.5     // lowest internal scale of the window size
+#define RESOLUTION_STEP         0.1     // scale regained after a window without a slow frame
+#define RESOLUTION_WINDOW       30      // frames looked at before each change
+#define RESOLUTION_SLACK        1.05    // frames this much over the budget count as slow
+
+// scene rendered off screen at a scale of the window size, chosen from recent
+// frame times to stay within the budget, then stretched to the window
+typedef struct Resolution {
+    float budget;           // seconds per frame
+    float scale;
+    float ceiling;          // lowest scale found too slow since the board was idle
+    bool raised;            // the last change stepped up
+    RenderTexture2D target; // window sized, the scene uses its top left part
+    int width;              // window size of the target
+    int height;
+    float frameSum;         // frames of the current window
+    float frameMax;
+    int frameNum;
+} Resolution;
+
+Resolution* newResolution(float budget);
+void freeResolution(Resolution* resolution);
+bool resolutionUpdate(Resolution* resolution, float frameTime, bool idle);
+void beginScene(Resolution* resolution);
+void endScene(Resolution* resolution);
+
+#endif // RESOLUTION_H
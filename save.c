@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "save.h"
+
+#define SAVE_MOVE_SIZE      ((int)sizeof(HistoryMove))
+
+static uint32_t saveChecksum(const unsigned char* data, size_t length){
+    // four independent multiply-xor lanes over 8 byte words, bytes for the tail
+    uint64_t lanes[4] = { 0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL, 0x27D4EB2F165667C5ULL };
+    size_t i = 0;
+    for(; i+32 <= length; i += 32)
+        for(int k = 0; k < 4; k++){
+            uint64_t word;
+            memcpy(&word, data+i+8*k, 8);
+            lanes[k] = (lanes[k]^word)*0x9E3779B97F4A7C15ULL;
+            lanes[k] ^= lanes[k] >> 29;
+        }
+    uint64_t h = lanes[0]^(lanes[1]*3)^(lanes[2]*5)^(lanes[3]*7)^length;
+    for(; i < length; i++) h = (h^data[i])*0x100000001B3ULL;
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    return (uint32_t)h;
+}
+
+static uint32_t blobChecksum(const unsigned char* blob, size_t length){
+    // the whole blob, header included, read with a zero checksum field
+    unsigned char* copy = malloc(length);
+    memcpy(copy, blob, length);
+    memset(copy+offsetof(SaveHeader, checksum), 0, sizeof(uint32_t));
+    uint32_t checksum = saveChecksum(copy, length);
+    free(copy);
+    return checksum;
+}
+
+size_t saveSize(const History* history){
+    return sizeof(SaveHeader)+history->board.colorNum*sizeof(Color)+boardSize(&history->board)
+           +(size_t)(history->last-history->first)*SAVE_MOVE_SIZE;
+}
+
+size_t saveGame(const History* history, unsigned char* blob){
+    // blob must hold saveSize bytes, returns the # of bytes written
+    const Board* board = &history->board;
+    SaveHeader header = { SAVE_MAGIC, SAVE_VERSION, board->capacity, 0, saveSize(history),
+                          board->tubeNum, board->colorNum, selectedTube, history->last-history->first,
+                          history->first, history->current, history->last };
+    unsigned char* p = blob+sizeof(SaveHeader);
+    memcpy(p, &board->palette[1], board->colorNum*sizeof(Color));
+    p += board->colorNum*sizeof(Color);
+    memcpy(p, history->state, boardSize(board));
+    p += boardSize(board);
+    // the kept pours are at most two pieces of the ring
+    long long moveNum = history->last-history->first;
+    int start = history->first % HISTORY_MOVE_NUM;
+    int head = min(moveNum, HISTORY_MOVE_NUM-start);
+    memcpy(p, history->moves+start, (size_t)head*SAVE_MOVE_SIZE);
+    memcpy(p+(size_t)head*SAVE_MOVE_SIZE, history->moves, (size_t)(moveNum-head)*SAVE_MOVE_SIZE);
+    memcpy(blob, &header, sizeof(SaveHeader));
+    header.checksum = blobChecksum(blob, header.length);
+    memcpy(blob, &header, sizeof(SaveHeader));
+    return header.length;
+}
+
+bool loadGame(const unsigned char* blob, size_t length, Tubes** tubes, History** history){
+    // checks everything before touching the game, then rebuilds still tubes and the history
+    SaveHeader header;
+    if(length < sizeof(SaveHeader)) return false;
+    memcpy(&header, blob, sizeof(SaveHeader));
+    if(header.magic != SAVE_MAGIC || header.version != SAVE_VERSION || header.length != length) return false;
+    if(header.checksum != blobChecksum(blob, length)) return false;
+    if(header.capacity < MIN_TUBE_WATER || header.capacity > MAX_TUBE_WATER || header.tubeNum == 0 ||
+       header.tubeNum > UINT16_MAX || header.colorNum > BOARD_MAX_COLOR || header.moveNum > HISTORY_MOVE_NUM ||
+       header.first < 0 || header.current < header.first || header.last < header.current ||
+       header.last-header.first != header.moveNum || header.selectedTube < -1 || header.selectedTube >= (int32_t)header.tubeNum)
+        return false;
+    Board board;
+    board.tubeNum = header.tubeNum;
+    board.capacity = header.capacity;
+    board.colorNum = header.colorNum;
+    if(length != sizeof(SaveHeader)+board.colorNum*sizeof(Color)+boardSize(&board)+(size_t)header.moveNum*SAVE_MOVE_SIZE)
+        return false;
+    const unsigned char* p = blob+sizeof(SaveHeader);
+    board.palette[BOARD_EMPTY] = BLANK;
+    memcpy(&board.palette[1], p, board.colorNum*sizeof(Color));
+    p += board.colorNum*sizeof(Color);
+    const unsigned char* state = p;
+    p += boardSize(&board);
+    for(int i = 0; i < boardSize(&board); i++)
+        if(state[i] > board.colorNum) return false;
+
+    History* h = newHistoryFromBoard(&board, state);
+    h->first = header.first;
+    h->current = header.current;
+    h->last = header.last;
+    for(long long i = h->first; i < h->last; i++){
+        HistoryMove m;
+        memcpy(&m, p, SAVE_MOVE_SIZE);
+        if(m.from >= board.tubeNum || m.to >= board.tubeNum || m.from == m.to || m.count == 0 || m.count > board.capacity){
+            freeHistory(h);
+            return false;
+        }
+        h->moves[i % HISTORY_MOVE_NUM] = m;
+        p += SAVE_MOVE_SIZE;
+    }
+    if(!historyRebuild(h)){
+        freeHistory(h);
+        return false;
+    }
+
+    Tubes* t = boardNewTubes(&board, state);
+    selectedTube = -1;
+    if(header.selectedTube >= 0 && countWater(t->contains[header.selectedTube]) > 0){
+        // lift the selected tube without playing the animation
+        selectTube(t, header.selectedTube);
+        while(animationIdx[header.selectedTube] > 0) updateTubes(t);
+    }
+    *tubes = t;
+    *history = h;
+    return true;
+}
+
+bool saveGameFile(const char* path, const History* history){
+    // written next to the old save and renamed over it, a crash never leaves half a save
+    char tmpPath[4096];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    unsigned char* blob = malloc(saveSize(history));
+    size_t length = saveGame(history, blob);
+    FILE* file = fopen(tmpPath, "wb");
+    bool ok = file && fwrite(blob, 1, length, file) == length;
+    if(file) ok = fclose(file) == 0 && ok;
+    free(blob);
+    return ok && rename(tmpPath, path) == 0;
+}
+
+bool loadGameFile(const char* path, Tubes** tubes, History** history){
+    FILE* file = fopen(path, "rb");
+    if(!file) return false;
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    unsigned char* blob = malloc(length > 0 ? length : 1);
+    bool ok = length > 0 && fread(blob, 1, length, file) == (size_t)length &&
+              loadGame(blob, length, tubes, history);
+    free(blob);
+    fclose(file);
+    return ok;
+}
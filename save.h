@@ -0,0 +1,34 @@
+#ifndef SAVE_H
+#define SAVE_H
+
+#include "history.h"
+
+#define SAVE_FILE           "savegame.bin"
+#define SAVE_MAGIC          0x56535357u // "WSSV"
+#define SAVE_VERSION        2
+
+// saved game, little endian, followed by the palette (colorNum colors from id 1),
+// the board at `current` and the kept pours as HistoryMove, oldest first.
+// pours still animating are saved as done, restoring gives still tubes.
+typedef struct SaveHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t capacity;
+    uint32_t checksum;      // of the whole blob with this field 0
+    uint32_t length;        // whole blob, header included
+    uint32_t tubeNum;
+    uint32_t colorNum;
+    int32_t selectedTube;
+    uint32_t moveNum;       // last-first
+    int64_t first;
+    int64_t current;
+    int64_t last;
+} SaveHeader;
+
+size_t saveSize(const History* history);
+size_t saveGame(const History* history, unsigned char* blob);
+bool loadGame(const unsigned char* blob, size_t length, Tubes** tubes, History** history);
+bool saveGameFile(const char* path, const History* history);
+bool loadGameFile(const char* path, Tubes** tubes, History** history);
+
+#endif // SAVE_H
@@ -0,0 +1,239 @@
+#include <string.h>
+#include <pthread.h>
+#include "simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_X86
+#endif
+
+// bit j of carePattern[capacity][phase] is set when byte phase+j of a board is not
+// the top unit of its tube, so it has to equal the next byte in a uniform tube
+static uint32_t carePattern[SIMD_MAX_CAPACITY+1][SIMD_MAX_CAPACITY];
+static pthread_once_t simdOnce = PTHREAD_ONCE_INIT;
+static const char* simdLevel = "scalar";
+
+static bool solvedResolve(const unsigned char* state, int size, int capacity);
+static bool equalResolve(const unsigned char* a, const unsigned char* b, int size);
+static void eqBitsResolve(const unsigned char* state, int size, uint64_t* bits);
+static void eqBitsScalar(const unsigned char* state, int size, uint64_t* bits);
+
+static bool (*solvedImpl)(const unsigned char*, int, int) = solvedResolve;
+static bool (*equalImpl)(const unsigned char*, const unsigned char*, int) = equalResolve;
+static void (*eqBitsImpl)(const unsigned char*, int, uint64_t*) = eqBitsResolve;
+
+bool stateSolvedScalar(const unsigned char* state, int size, int capacity){
+    for(int i = 0; i < size; i += capacity)
+        for(int j = 1; j < capacity; j++)
+            if(state[i+j] != state[i]) return false;
+    return true;
+}
+
+bool stateEqualScalar(const unsigned char* a, const unsigned char* b, int size){
+    for(int i = 0; i < size; i++)
+        if(a[i] != b[i]) return false;
+    return true;
+}
+
+static void eqBitsScalar(const unsigned char* state, int size, uint64_t* bits){
+    // bit i is set when byte i equals byte i+1
+    memset(bits, 0, sizeof(uint64_t)*((size+63)/64));
+    for(int i = 0; i+1 < size; i++)
+        if(state[i] == state[i+1]) bits[i >> 6] |= 1ULL << (i & 63);
+}
+
+static bool tailSolved(const unsigned char* state, int size, int capacity, int o, int phase){
+    for(; o+1 < size; o++){
+        if(phase != capacity-1 && state[o] != state[o+1]) return false;
+        if(++phase == capacity) phase = 0;
+    }
+    return true;
+}
+
+#ifdef SIMD_X86
+__attribute__((target("sse2")))
+static inline bool windowSse2(const unsigned char* state, int o, uint32_t care){
+    __m128i a = _mm_loadu_si128((const __m128i*)(state+o));
+    __m128i b = _mm_loadu_si128((const __m128i*)(state+o+1));
+    return !(~(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) & care & 0xFFFF);
+}
+
+__attribute__((target("sse2")))
+static bool solvedFromSse2(const unsigned char* state, int size, int capacity, int o, int phase){
+    // compare every byte with its upper neighbor 16 at a time, only bytes inside a tube matter
+    int step = 16 % capacity;
+    for(; o+17 <= size; o += 16){
+        if(!windowSse2(state, o, carePattern[capacity][phase])) return false;
+        phase += step;
+        if(phase >= capacity) phase -= capacity;
+    }
+    if(o+1 >= size) return true;
+    // the rest in one window ending at the last byte, overlapping bytes already checked
+    if(size >= 17) return windowSse2(state, size-17, carePattern[capacity][(size-17) % capacity]);
+    return tailSolved(state, size, capacity, o, phase);
+}
+
+__attribute__((target("sse2")))
+static bool solvedSse2(const unsigned char* state, int size, int capacity){
+    return solvedFromSse2(state, size, capacity, 0, 0);
+}
+
+__attribute__((target("sse2")))
+static bool equalSse2(const unsigned char* a, const unsigned char* b, int size){
+    int o = 0;
+    for(; o+16 <= size; o += 16){
+        __m128i x = _mm_loadu_si128((const __m128i*)(a+o));
+        __m128i y = _mm_loadu_si128((const __m128i*)(b+o));
+        if(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xFFFF) return false;
+    }
+    if(o == size) return true;
+    if(size >= 16) return equalSse2(a+size-16, b+size-16, 16);
+    return stateEqualScalar(a+o, b+o, size-o);
+}
+
+__attribute__((target("sse2")))
+static void eqBitsSse2(const unsigned char* state, int size, uint64_t* bits){
+    memset(bits, 0, sizeof(uint64_t)*((size+63)/64));
+    int o = 0;
+    for(; o+17 <= size; o += 16){
+        __m128i a = _mm_loadu_si128((const __m128i*)(state+o));
+        __m128i b = _mm_loadu_si128((const __m128i*)(state+o+1));
+        bits[o >> 6] |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) << (o & 63);
+    }
+    for(; o+1 < size; o++)
+        if(state[o] == state[o+1]) bits[o >> 6] |= 1ULL << (o & 63);
+}
+
+__attribute__((target("avx2")))
+static inline bool windowAvx2(const unsigned char* state, int o, uint32_t care){
+    __m256i a = _mm256_loadu_si256((const __m256i*)(state+o));
+    __m256i b = _mm256_loadu_si256((const __m256i*)(state+o+1));
+    return !(~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)) & care);
+}
+
+__attribute__((target("avx2")))
+static bool solvedAvx2(const unsigned char* state, int size, int capacity){
+    int o = 0, phase = 0, step = 32 % capacity;
+    for(; o+33 <= size; o += 32){
+        if(!windowAvx2(state, o, carePattern[capacity][phase])) return false;
+        phase += step;
+        if(phase >= capacity) phase -= capacity;
+    }
+    if(o+1 >= size) return true;
+    if(size >= 33) return windowAvx2(state, size-33, carePattern[capacity][(size-33) % capacity]);
+    return solvedFromSse2(state, size, capacity, o, phase);
+}
+
+__attribute__((target("avx2")))
+static bool equalAvx2(const unsigned char* a, const unsigned char* b, int size){
+    int o = 0;
+    for(; o+32 <= size; o += 32){
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a+o));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b+o));
+        if((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)) != 0xFFFFFFFFu) return false;
+    }
+    if(o == size) return true;
+    if(size >= 32) return equalAvx2(a+size-32, b+size-32, 32);
+    return equalSse2(a+o, b+o, size-o);
+}
+
+__attribute__((target("avx2")))
+static void eqBitsAvx2(const unsigned char* state, int size, uint64_t* bits){
+    memset(bits, 0, sizeof(uint64_t)*((size+63)/64));
+    int o = 0;
+    for(; o+33 <= size; o += 32){
+        __m256i a = _mm256_loadu_si256((const __m256i*)(state+o));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(state+o+1));
+        bits[o >> 6] |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)) << (o & 63);
+    }
+    for(; o+1 < size; o++)
+        if(state[o] == state[o+1]) bits[o >> 6] |= 1ULL << (o & 63);
+}
+#endif
+
+static void simdInit(void){
+    for(int capacity = 1; capacity <= SIMD_MAX_CAPACITY; capacity++)
+        for(int phase = 0; phase < capacity; phase++){
+            uint32_t pattern = 0;
+            for(int j = 0; j < 32; j++)
+                if((phase+j) % capacity != capacity-1) pattern |= 1u << j;
+            carePattern[capacity][phase] = pattern;
+        }
+    bool (*solved)(const unsigned char*, int, int) = stateSolvedScalar;
+    bool (*equal)(const unsigned char*, const unsigned char*, int) = stateEqualScalar;
+    void (*eqBits)(const unsigned char*, int, uint64_t*) = eqBitsScalar;
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")){
+        solved = solvedAvx2; equal = equalAvx2; eqBits = eqBitsAvx2;
+        simdLevel = "avx2";
+    } else if(__builtin_cpu_supports("sse2")){
+        solved = solvedSse2; equal = equalSse2; eqBits = eqBitsSse2;
+        simdLevel = "sse2";
+    }
+#endif
+    __atomic_store_n(&solvedImpl, solved, __ATOMIC_RELEASE);
+    __atomic_store_n(&equalImpl, equal, __ATOMIC_RELEASE);
+    __atomic_store_n(&eqBitsImpl, eqBits, __ATOMIC_RELEASE);
+}
+
+// the first call of each kernel picks the implementation for all of them
+static bool solvedResolve(const unsigned char* state, int size, int capacity){
+    pthread_once(&simdOnce, simdInit);
+    return solvedImpl(state, size, capacity);
+}
+
+static bool equalResolve(const unsigned char* a, const unsigned char* b, int size){
+    pthread_once(&simdOnce, simdInit);
+    return equalImpl(a, b, size);
+}
+
+static void eqBitsResolve(const unsigned char* state, int size, uint64_t* bits){
+    pthread_once(&simdOnce, simdInit);
+    eqBitsImpl(state, size, bits);
+}
+
+const char* simdName(void){
+    pthread_once(&simdOnce, simdInit);
+    return simdLevel;
+}
+
+bool stateSolved(const unsigned char* state, int size, int capacity){
+    // every tube empty or full of one color: all units of a tube equal
+    if(capacity > SIMD_MAX_CAPACITY) return stateSolvedScalar(state, size, capacity);
+    return solvedImpl(state, size, capacity);
+}
+
+bool stateEqual(const unsigned char* a, const unsigned char* b, int size){
+    return equalImpl(a, b, size);
+}
+
+static void uniformFromBits(const uint64_t* bits, int size, int capacity, uint64_t* mask){
+    // tube t is uniform when the capacity-1 bits from t*capacity are all set
+    int tubeNum = size/capacity;
+    uint64_t need = capacity > 1 ? (1ULL << (capacity-1))-1 : 0;
+    memset(mask, 0, sizeof(uint64_t)*((tubeNum+63)/64));
+    for(int t = 0; t < tubeNum; t++){
+        int start = t*capacity, word = start >> 6, shift = start & 63;
+        uint64_t window = bits[word] >> shift;
+        if(shift+capacity-1 > 64) window |= bits[word+1] << (64-shift);
+        if((window & need) == need) mask[t >> 6] |= 1ULL << (t & 63);
+    }
+}
+
+void stateUniformScalar(const unsigned char* state, int size, int capacity, uint64_t* mask){
+    uint64_t bits[(size+63)/64];
+    eqBitsScalar(state, size, bits);
+    uniformFromBits(bits, size, capacity, mask);
+}
+
+void stateUniform(const unsigned char* state, int size, int capacity, uint64_t* mask){
+    // bit t of mask is set when every unit of tube t is the same (empty included)
+    if(capacity > SIMD_MAX_CAPACITY){
+        stateUniformScalar(state, size, capacity, mask);
+        return;
+    }
+    uint64_t bits[(size+63)/64];
+    eqBitsImpl(state, size, bits);
+    uniformFromBits(bits, size, capacity, mask);
+}
@@ -0,0 +1,20 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SIMD_MAX_CAPACITY   16  // largest tube capacity the kernels handle
+
+// vectorized kernels over packed boards (see board.h), AVX2 or SSE2 picked at
+// first use with a scalar fallback; `size` is tubeNum*capacity bytes
+bool stateSolved(const unsigned char* state, int size, int capacity);
+bool stateEqual(const unsigned char* a, const unsigned char* b, int size);
+void stateUniform(const unsigned char* state, int size, int capacity, uint64_t* mask);
+
+bool stateSolvedScalar(const unsigned char* state, int size, int capacity);
+bool stateEqualScalar(const unsigned char* a, const unsigned char* b, int size);
+void stateUniformScalar(const unsigned char* state, int size, int capacity, uint64_t* mask);
+const char* simdName(void);
+
+#endif // SIMD_H
@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "solver.h"
+#include "arena.h"
+#include "trace.h"
+
+int SOLVER_THREADS = 0;
+int SOLVER_PRUNE = PRUNE_ALL;
+
+typedef struct Candidate {
+    uint64_t hash;
+    int score;
+    int parent;  // index of the parent state in the current layer
+    Move move;
+    bool solved;
+} Candidate;
+
+typedef struct BeamStep {
+    int parent;
+    Move move;
+} BeamStep;
+
+typedef struct HashSet {
+    uint64_t* slots; // 0 marks an empty slot
+    size_t mask;
+    size_t size;
+} HashSet;
+
+typedef struct BeamWorker {
+    const Board* board;
+    const unsigned char* layer;
+    const BeamStep* steps;  // moves that led to the current layer, NULL for the start board
+    const HashSet* visited;
+    int first, last;    // parents [first, last) of the current layer
+    int beamWidth;
+    Candidate* heap;    // max-heap of the beamWidth best candidates of this worker
+    int heapSize;
+    HashSet pushed;     // hashes pushed to the heap, so equal states reached by different pours count once
+    long long expanded;
+} BeamWorker;
+
+int solverThreadNum(void){
+    if(SOLVER_THREADS > 0) return SOLVER_THREADS;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+}
+
+static void hashSetInit(HashSet* set, size_t expected){
+    size_t cap = 16;
+    while(cap < expected*2) cap <<= 1;
+    set->slots = calloc(cap, sizeof(uint64_t));
+    set->mask = cap-1;
+    set->size = 0;
+}
+
+static bool hashSetContains(const HashSet* set, uint64_t hash){
+    for(size_t i = hash & set->mask; set->slots[i]; i = (i+1) & set->mask)
+        if(set->slots[i] == hash) return true;
+    return false;
+}
+
+static bool hashSetInsert(HashSet* set, uint64_t hash){
+    if((set->size+1)*2 > set->mask+1){
+        HashSet grown;
+        hashSetInit(&grown, (set->mask+1));
+        for(size_t i = 0; i <= set->mask; i++)
+            if(set->slots[i]) hashSetInsert(&grown, set->slots[i]);
+        free(set->slots);
+        *set = grown;
+    }
+    size_t i = hash & set->mask;
+    for(; set->slots[i]; i = (i+1) & set->mask)
+        if(set->slots[i] == hash) return false;
+    set->slots[i] = hash;
+    set->size++;
+    return true;
+}
+
+static bool candidateBetter(const Candidate* a, const Candidate* b){
+    // lower score first, hash breaks ties so results do not depend on thread timing
+    if(a->score != b->score) return a->score < b->score;
+    return a->hash < b->hash;
+}
+
+static int candidateCompare(const void* a, const void* b){
+    const Candidate* x = a;
+    const Candidate* y = b;
+    if(candidateBetter(x, y)) return -1;
+    if(candidateBetter(y, x)) return 1;
+    return 0;
+}
+
+static bool heapPush(BeamWorker* worker, Candidate cand){
+    // keep only the beamWidth best candidates, the worst one sits at the root
+    Candidate* heap = worker->heap;
+    int i;
+    if(worker->heapSize < worker->beamWidth){
+        i = worker->heapSize++;
+        while(i > 0 && candidateBetter(&heap[(i-1)/2], &cand)){
+            heap[i] = heap[(i-1)/2];
+            i = (i-1)/2;
+        }
+        heap[i] = cand;
+        return true;
+    }
+    if(!candidateBetter(&cand, &heap[0])) return false;
+    i = 0;
+    while(1){
+        int child = 2*i+1;
+        if(child >= worker->heapSize) break;
+        if(child+1 < worker->heapSize && candidateBetter(&heap[child], &heap[child+1])) child++;
+        if(!candidateBetter(&cand, &heap[child])) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = cand;
+    return true;
+}
+
+static void* expandLayer(void* arg){
+    BeamWorker* worker = arg;
+    const Board* board = worker->board;
+    int size = boardSize(board);
+    unsigned char* scratch = malloc(size);
+    Move* moves = malloc(sizeof(Move)*board->tubeNum*max(board->tubeNum-1, 1));
+    worker->heapSize = 0;
+    worker->expanded = 0;
+    hashSetInit(&worker->pushed, worker->beamWidth*2);
+    TRACE_BEGIN("expandLayer");
+    for(int p = worker->first; p < worker->last; p++){
+        memcpy(scratch, worker->layer+(size_t)p*size, size);
+        Move last = worker->steps ? worker->steps[p].move : NO_MOVE;
+        int moveNum = boardPrunedMoves(board, scratch, last, SOLVER_PRUNE, moves);
+        worker->expanded++;
+        for(int m = 0; m < moveNum; m++){
+            boardPour(board, scratch, moves[m].from, moves[m].to);
+            uint64_t hash = boardHash(board, scratch);
+            if(!hashSetContains(worker->visited, hash) && !hashSetContains(&worker->pushed, hash)){
+                Candidate cand = { hash, boardHeuristic(board, scratch), p, moves[m], boardSolved(board, scratch) };
+                if(cand.solved) cand.score = -1; // always kept
+                if(heapPush(worker, cand)) hashSetInsert(&worker->pushed, hash);
+            }
+            boardUnpour(board, scratch, moves[m]);
+        }
+    }
+    TRACE_END("expandLayer");
+    free(worker->pushed.slots);
+    free(moves);
+    free(scratch);
+    return NULL;
+}
+
+Solution beamSearch(const Board* board, const unsigned char* start, int beamWidth, int maxDepth, int threadNum){
+    // layered beam search: every layer keeps the beamWidth best states by
+    // boardHeuristic, states reached before are dropped by canonical hash.
+    // threadNum 0 expands layers on solverThreadNum() threads
+    Solution solution = { false, 0, NULL, 0 };
+    int size = boardSize(board);
+    if(boardSolved(board, start)){
+        solution.solved = true;
+        return solution;
+    }
+
+    TRACE_BEGIN("beamSearch");
+    if(threadNum <= 0) threadNum = solverThreadNum();
+    pthread_t* threads = malloc(sizeof(pthread_t)*threadNum);
+    BeamWorker* workers = malloc(sizeof(BeamWorker)*threadNum);
+    for(int t = 0; t < threadNum; t++)
+        workers[t].heap = malloc(sizeof(Candidate)*beamWidth);
+    Candidate* merged = malloc(sizeof(Candidate)*beamWidth*threadNum);
+    unsigned char* layer = malloc((size_t)beamWidth*size);
+    unsigned char* next = malloc((size_t)beamWidth*size);
+    // the steps of every layer come from one arena, dropped at once at the end
+    Arena stepArena;
+    arenaInit(&stepArena, sizeof(BeamStep)*beamWidth*(size_t)maxDepth);
+    BeamStep** steps = malloc(sizeof(BeamStep*)*maxDepth);
+    HashSet visited;
+    hashSetInit(&visited, (size_t)beamWidth*4);
+
+    memcpy(layer, start, size);
+    hashSetInsert(&visited, boardHash(board, start));
+    int layerNum = 1, depth = 0, goal = -1;
+
+    while(depth < maxDepth && layerNum > 0 && goal < 0){
+        // expand the parents of this layer in parallel
+        int workerNum = min(threadNum, layerNum);
+        for(int t = 0; t < workerNum; t++){
+            workers[t] = (BeamWorker){ board, layer, depth > 0 ? steps[depth-1] : NULL, &visited,
+                                       layerNum*t/workerNum, layerNum*(t+1)/workerNum,
+                                       beamWidth, workers[t].heap, 0 };
+            if(workerNum == 1) expandLayer(&workers[t]);
+            else pthread_create(&threads[t], NULL, expandLayer, &workers[t]);
+        }
+        int mergedNum = 0;
+        for(int t = 0; t < workerNum; t++){
+            if(workerNum > 1) pthread_join(threads[t], NULL);
+            memcpy(merged+mergedNum, workers[t].heap, sizeof(Candidate)*workers[t].heapSize);
+            mergedNum += workers[t].heapSize;
+            solution.expanded += workers[t].expanded;
+        }
+
+        // keep the best unique candidates as the next layer
+        qsort(merged, mergedNum, sizeof(Candidate), candidateCompare);
+        steps[depth] = arenaAlloc(&stepArena, sizeof(BeamStep)*beamWidth, sizeof(int));
+        int nextNum = 0;
+        for(int c = 0; c < mergedNum && nextNum < beamWidth; c++){
+            if(!hashSetInsert(&visited, merged[c].hash)) continue;
+            unsigned char* state = next+(size_t)nextNum*size;
+            memcpy(state, layer+(size_t)merged[c].parent*size, size);
+            boardPour(board, state, merged[c].move.from, merged[c].move.to);
+            steps[depth][nextNum] = (BeamStep){ merged[c].parent, merged[c].move };
+            if(merged[c].solved && goal < 0) goal = nextNum;
+            nextNum++;
+        }
+        unsigned char* tmp = layer; layer = next; next = tmp;
+        layerNum = nextNum;
+        depth++;
+    }
+
+    if(goal >= 0){
+        solution.solved = true;
+        solution.moveNum = depth;
+        solution.moves = malloc(sizeof(Move)*depth);
+        for(int d = depth-1, idx = goal; d >= 0; d--){
+            solution.moves[d] = steps[d][idx].move;
+            idx = steps[d][idx].parent;
+        }
+    }
+
+    arenaFree(&stepArena);
+    for(int t = 0; t < threadNum; t++) free(workers[t].heap);
+    free(steps);
+    free(visited.slots);
+    free(next);
+    free(layer);
+    free(merged);
+    free(workers);
+    free(threads);
+    TRACE_END("beamSearch");
+    return solution;
+}
+
+void freeSolution(Solution* solution){
+    free(solution->moves);
+    solution->moves = NULL;
+    solution->moveNum = 0;
+}
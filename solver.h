@@ -0,0 +1,23 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include "board.h"
+
+#define BEAM_WIDTH          256
+#define BEAM_MAX_DEPTH      1000
+
+extern int SOLVER_THREADS; // # of worker threads, 0 for one per online core
+extern int SOLVER_PRUNE;   // move pruning rules applied by every solver
+
+typedef struct Solution {
+    bool solved;
+    int moveNum;
+    Move* moves;        // moveNum moves from the start board, NULL if not solved
+    long long expanded; // # of states expanded by the search
+} Solution;
+
+int solverThreadNum(void);
+Solution beamSearch(const Board* board, const unsigned char* start, int beamWidth, int maxDepth, int threadNum);
+void freeSolution(Solution* solution);
+
+#endif // SOLVER_H
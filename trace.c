@@ -0,0 +1,145 @@
+#ifdef WATERSORT_TRACE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include "trace.h"
+
+typedef struct TraceEvent {
+    double ts;          // microseconds since traceOpen
+    const char* name;
+    int pid;
+    int tid;
+    char phase;
+} TraceEvent;
+
+// single producer, single consumer: the owning thread moves head, the flusher moves tail
+typedef struct TraceRing {
+    TraceEvent events[TRACE_RING_SIZE];
+    unsigned head;
+    unsigned tail;
+    int owned;          // a live thread writes here, an ended thread's ring is taken by the next one
+    int tid;
+    struct TraceRing* next;
+} TraceRing;
+
+static TraceRing* rings;            // every ring made, pushed without a lock and never removed
+static __thread TraceRing* ring;
+static pthread_key_t ringKey;
+static FILE* traceFile;
+static pthread_t flusher;
+static int traceOn, stopping;
+static int maxTube = -1;
+static long long dropped;
+static double traceStart;
+
+static double traceNow(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec*1e6+now.tv_nsec/1e3-traceStart;
+}
+
+static void releaseRing(void* r){
+    // the thread ended, its events stay until flushed
+    __atomic_store_n(&((TraceRing*)r)->owned, 0, __ATOMIC_RELEASE);
+}
+
+static TraceRing* acquireRing(void){
+    TraceRing* r;
+    for(r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); r; r = r->next){
+        int unowned = 0;
+        if(__atomic_compare_exchange_n(&r->owned, &unowned, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) break;
+    }
+    if(!r){
+        r = calloc(1, sizeof(TraceRing));
+        r->owned = 1;
+        r->next = __atomic_load_n(&rings, __ATOMIC_RELAXED);
+        while(!__atomic_compare_exchange_n(&rings, &r->next, r, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+    r->tid = syscall(SYS_gettid);
+    pthread_setspecific(ringKey, r);
+    return r;
+}
+
+void traceEvent(char phase, const char* name, int tube){
+    // never blocks: an event that finds its ring full is dropped and counted
+    if(!__atomic_load_n(&traceOn, __ATOMIC_ACQUIRE)) return;
+    if(!ring) ring = acquireRing();
+    unsigned head = ring->head;
+    if(head-__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == TRACE_RING_SIZE){
+        __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    if(tube < 0){
+        ring->events[head & (TRACE_RING_SIZE-1)] = (TraceEvent){ traceNow(), name, TRACE_PID, ring->tid, phase };
+    } else {
+        ring->events[head & (TRACE_RING_SIZE-1)] = (TraceEvent){ traceNow(), name, TRACE_TUBE_PID, tube, phase };
+        int seen = __atomic_load_n(&maxTube, __ATOMIC_RELAXED);
+        while(tube > seen && !__atomic_compare_exchange_n(&maxTube, &seen, tube, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    }
+    __atomic_store_n(&ring->head, head+1, __ATOMIC_RELEASE);
+}
+
+static void drainRings(void){
+    for(TraceRing* r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); r; r = r->next){
+        unsigned tail = r->tail, head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        for(; tail != head; tail++){
+            const TraceEvent* e = &r->events[tail & (TRACE_RING_SIZE-1)];
+            fprintf(traceFile, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}",
+                    e->name, e->phase, e->ts, e->pid, e->tid);
+        }
+        __atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+    }
+}
+
+static void* flushRings(void* arg){
+    struct timespec period = { 0, TRACE_FLUSH_MS*1000000L };
+    while(!__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)){
+        nanosleep(&period, NULL);
+        drainRings();
+    }
+    return NULL;
+}
+
+void traceOpen(const char* path){
+    // events are written from here until the process exits
+    traceFile = fopen(path, "w");
+    if(!traceFile){
+        printf("Error: cannot open %s\n", path);
+        exit(-1);
+    }
+    traceStart = 0;
+    traceStart = traceNow();
+    fprintf(traceFile, "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"Watersort\"}}", TRACE_PID);
+    fprintf(traceFile, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"main\"}}",
+            TRACE_PID, (int)syscall(SYS_gettid));
+    fprintf(traceFile, ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"Tubes\"}}", TRACE_TUBE_PID);
+    pthread_key_create(&ringKey, releaseRing);
+    __atomic_store_n(&traceOn, 1, __ATOMIC_RELEASE);
+    pthread_create(&flusher, NULL, flushRings, NULL);
+    atexit(traceClose);
+}
+
+void traceClose(void){
+    if(!traceFile) return;
+    __atomic_store_n(&traceOn, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+    pthread_join(flusher, NULL);
+    drainRings();
+    for(int i = 0; i <= maxTube; i++){
+        fprintf(traceFile, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"Tube %d\"}}",
+                TRACE_TUBE_PID, i, i);
+        fprintf(traceFile, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"sort_index\":%d}}",
+                TRACE_TUBE_PID, i, i);
+    }
+    fprintf(traceFile, "\n]\n");
+    fclose(traceFile);
+    traceFile = NULL;
+    if(dropped > 0) printf("Trace: %lld events dropped, rings were full\n", dropped);
+}
+
+#endif // WATERSORT_TRACE
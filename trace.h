@@ -0,0 +1,33 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// Chrome trace events (chrome://tracing, ui.perfetto.dev), built in with
+// -DWATERSORT_TRACE (make -B TRACE=1). without it every macro is empty.
+// names must be string literals or otherwise live until traceClose
+
+#define TRACE_RING_SIZE     16384   // events one thread can buffer between two flushes, a power of 2
+#define TRACE_FLUSH_MS      10      // flusher period
+#define TRACE_PID           1       // the game's threads
+#define TRACE_TUBE_PID      2       // a process of its own for the tubes, tube n is tid n so no real tid can collide
+
+#ifdef WATERSORT_TRACE
+
+void traceOpen(const char* path);
+void traceClose(void);
+void traceEvent(char phase, const char* name, int tube);  // tube < 0: the calling thread's track
+
+#define TRACE_BEGIN(name)               traceEvent('B', name, -1)
+#define TRACE_END(name)                 traceEvent('E', name, -1)
+#define TRACE_TUBE_BEGIN(name, tube)    traceEvent('B', name, tube)
+#define TRACE_TUBE_END(tube)            traceEvent('E', "", tube)
+
+#else
+
+#define TRACE_BEGIN(name)               ((void)0)
+#define TRACE_END(name)                 ((void)0)
+#define TRACE_TUBE_BEGIN(name, tube)    ((void)0)
+#define TRACE_TUBE_END(tube)            ((void)0)
+
+#endif // WATERSORT_TRACE
+
+#endif // TRACE_H
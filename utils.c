@@ -1,6 +1,13 @@
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include "raylib.h"
+#include "rlgl.h"
 #include "utils.h"
+#include "layout.h"
+#include "trace.h"
+#include "perfcount.h"
 
 int frame = 0;
 int screenWidth = 700;
@@ -10,25 +17,31 @@ int screenHeight = 600;
 
 int selectedTube = -1;
 int TUBE_NUM    = 5;
+int TUBE_CAPACITY   = 4; // water units per tube of the current level, see setTubeCapacity
 int TUBE_THICKNESS  = 5;
 float TUBE_WIDTH    = 80.0;
 float TUBE_HEIGHT   = 300.0;
 float WATER_PERCENT = 0.9; // relative to TUBE_HEIGHT
-float targetAngle[] = { 90.0, 86.0, 77.0, 65.0, 45.0 };
+float targetAngle[MAX_TUBE_WATER+1] = { 90.0, 86.0, 77.0, 65.0, 45.0 }; // tilt angle by water level
 
 float HEIGHT_SELECT = 15.0;
 float HEIGHT_POUR   = 15.0;
 int FRAME_SELECT    = 10;
 int FRAME_MOVE      = 30;
 int FRAME_POUR      = 90;
-float animationList[MAX_TUBE_NUM][MAX_FRAME_NUM][ANIMATION_INFO_LENGTH];
-int animationIdx[MAX_TUBE_NUM];
+float (*animationList)[MAX_FRAME_NUM][ANIMATION_INFO_LENGTH]; // TUBE_NUM entries, see newTubes
+int* animationIdx;
 
-int countWater(Tube tube){
+// tilt angles of a 4 unit tube, spread over other capacities by water level ratio
+const float tiltAngles[] = { 90.0, 86.0, 77.0, 65.0, 45.0 };
+
+int countWater(const Color* contains){
+    // one loop for every capacity: constant-bound copies for 4/5/6/8 behind a
+    // switch made gameEnd slower at -O2, not faster
     int waterTotal = 0;
-    for(int i = 0; i < MAX_TUBE_WATER; i++){
-        // printf("counting water: idx: %d, empty? %d\n", i, emptyColor(tube.contains[i]));
-        if(emptyColor(tube.contains[i])) break;
+    for(int i = 0; i < TUBE_CAPACITY; i++){
+        // printf("counting water: idx: %d, empty? %d\n", i, emptyColor(contains[i]));
+        if(emptyColor(contains[i])) break;
         waterTotal++;
     }
     return waterTotal;
@@ -46,14 +59,29 @@ bool emptyColor(Color c){
     return sameColor(c, BLANK);
 }
 
-bool insideTube(Vector2 pos, Tube tube){
-    float rad = tube.angle*PI/180.0;
-    float radius = tube.rect.width/2.0;
-    Vector2 topLeft     = (Vector2){ tube.rect.x, tube.rect.y },
-            topRight    = (Vector2){ tube.rect.x+tube.rect.width*cos(rad), tube.rect.y+tube.rect.width*sin(rad) },
-            bottomLeft  = (Vector2){ tube.rect.x-tube.rect.height*sin(rad), tube.rect.y+tube.rect.height*cos(rad) },
-            bottomRight = (Vector2){ tube.rect.x+tube.rect.width*cos(rad)-tube.rect.height*sin(rad),
-                                     tube.rect.y+tube.rect.width*sin(rad)+tube.rect.height*cos(rad) };
+void setTubeCapacity(int capacity){
+    // called once per level: derive the tilt angles
+    if(capacity < MIN_TUBE_WATER || capacity > MAX_TUBE_WATER){
+        printf("Error: tube capacity %d not in [%d, %d]\n", capacity, MIN_TUBE_WATER, MAX_TUBE_WATER);
+        exit(-1);
+    }
+    TUBE_CAPACITY = capacity;
+    int knotNum = sizeof(tiltAngles)/sizeof(tiltAngles[0])-1;
+    for(int i = 0; i <= capacity; i++){
+        float pos = (float)i*knotNum/capacity;
+        int k = min((int)pos, knotNum-1);
+        targetAngle[i] = tiltAngles[k]+(pos-k)*(tiltAngles[k+1]-tiltAngles[k]);
+    }
+}
+
+bool insideTube(Vector2 pos, Rectangle rect, float angle){
+    float rad = angle*PI/180.0;
+    float radius = rect.width/2.0;
+    Vector2 topLeft     = (Vector2){ rect.x, rect.y },
+            topRight    = (Vector2){ rect.x+rect.width*cos(rad), rect.y+rect.width*sin(rad) },
+            bottomLeft  = (Vector2){ rect.x-rect.height*sin(rad), rect.y+rect.height*cos(rad) },
+            bottomRight = (Vector2){ rect.x+rect.width*cos(rad)-rect.height*sin(rad),
+                                     rect.y+rect.width*sin(rad)+rect.height*cos(rad) };
     Vector2 semiCircleCenter = (Vector2){ bottomLeft.x+radius*cos(rad), bottomLeft.y+radius*sin(rad) };
     
     if(CheckCollisionPointCircle(pos, semiCircleCenter, radius)) return true;
@@ -62,19 +90,40 @@ bool insideTube(Vector2 pos, Tube tube){
     return false;
 }
 
+Rectangle tubeBounds(Rectangle rect, float angle){
+    // axis aligned box around the shape tested by insideTube, one unit wider on each side
+    // so points on its edges still reach the exact test
+    float rad = angle*PI/180.0;
+    float radius = rect.width/2.0;
+    float c = cos(rad), s = sin(rad);
+    float xs[4] = { rect.x, rect.x+rect.width*c, rect.x-rect.height*s, rect.x+rect.width*c-rect.height*s },
+          ys[4] = { rect.y, rect.y+rect.width*s, rect.y+rect.height*c, rect.y+rect.width*s+rect.height*c };
+    Vector2 semiCircleCenter = (Vector2){ xs[2]+radius*c, ys[2]+radius*s };
+    float left = semiCircleCenter.x-radius, right = semiCircleCenter.x+radius,
+          top = semiCircleCenter.y-radius, bottom = semiCircleCenter.y+radius;
+    for(int i = 0; i < 4; i++){
+        left = min(left, xs[i]);
+        right = max(right, xs[i]);
+        top = min(top, ys[i]);
+        bottom = max(bottom, ys[i]);
+    }
+    return (Rectangle){ left-1, top-1, right-left+2, bottom-top+2 };
+}
+
 void copyAnimation(float* dst, float src[ANIMATION_INFO_LENGTH]){
     for(int i = 0; i < ANIMATION_INFO_LENGTH; i++) dst[i] = src[i];
 }
 
-void printTubeInfo(Tube tube, int idx){
+void printTubeInfo(Tubes* tubes, int idx){
+    Rectangle rect = tubes->rect[idx];
     printf("Tube %d info:\n", idx);
-    printf("<-- rect: (%.0f, %.0f, %.0f, %.0f) -->\n", tube.rect.x, tube.rect.y, tube.rect.width, tube.rect.height);
-    int waterTotal = countWater(tube);
-    printf("<-- Angle: %f, water level: %d, Animation stage: %d -->\n", tube.angle, waterTotal, tube.animationStage);
+    printf("<-- rect: (%.0f, %.0f, %.0f, %.0f) -->\n", rect.x, rect.y, rect.width, rect.height);
+    int waterTotal = countWater(tubes->contains[idx]);
+    printf("<-- Angle: %f, water level: %d, Animation stage: %d -->\n", tubes->angle[idx], waterTotal, tubes->animationStage[idx]);
 
     // printf("Colors(bottom to top):\n");
     // for(int i = 0; i < waterTotal; i++)
-    //     printf("(%u, %u, %u, %u)%c", tube.contains[i].r, tube.contains[i].g, tube.contains[i].b, tube.contains[i].a, ",\n"[i == waterTotal-1]);
+    //     printf("(%u, %u, %u, %u)%c", tubes->contains[idx][i].r, tubes->contains[idx][i].g, tubes->contains[idx][i].b, tubes->contains[idx][i].a, ",\n"[i == waterTotal-1]);
     printf("\n");
 }
 
@@ -93,58 +142,227 @@ float waterLevelAnimation(float pourProcessRatio, int waterTotal){
     // choose a non-linear function to make the water level change more natural
     // pourProcessRatio range: [0, 1]
     // output range: [0, 1]
-    return powf(pourProcessRatio, 8-waterTotal);
+    return powf(pourProcessRatio, 2*TUBE_CAPACITY-waterTotal);
 }
 
-float getPouredAmount(Tube* tubes, int idx){
+float getPouredAmount(Tubes* tubes, int idx){
     // get the amount of water units poured to tube idx at this frame
     float amount = 0;
     for(int i = 0; i < TUBE_NUM; i++){
-        if(animationIdx[i] > 0 && tubes[i].animationStage == POURING &&
+        if(animationIdx[i] > 0 && tubes->animationStage[i] == POURING &&
            animationList[i][animationIdx[i]][POURING_TO] == idx){
-            int c0 = countWater(tubes[i]), pourCnt = (int)animationList[i][animationIdx[i]][POUR_COUNT];
-            float pouringProcessRatio = (fabs(tubes[i].angle)-targetAngle[c0])/(targetAngle[c0-pourCnt]-targetAngle[c0]);
+            int c0 = countWater(tubes->contains[i]), pourCnt = (int)animationList[i][animationIdx[i]][POUR_COUNT];
+            float pouringProcessRatio = (fabs(tubes->angle[i])-targetAngle[c0])/(targetAngle[c0-pourCnt]-targetAngle[c0]);
             amount += pouringProcessRatio*pourCnt;
         }
     }
     return amount;
 }
 
-void initTube(Tube* tube, Rectangle rect, float angle, Color tubeColors[MAX_TUBE_WATER]){
-    (*tube).rect = rect;
-    (*tube).angle = angle;
+Tubes* newTubes(int tubeNum){
+    // storage for tubeNum tubes, the animation lists are resized along with it
+    Tubes* tubes = malloc(sizeof(Tubes));
+    tubes->contains = calloc(tubeNum, sizeof(tubes->contains[0]));
+    tubes->rect = calloc(tubeNum, sizeof(Rectangle));
+    tubes->angle = calloc(tubeNum, sizeof(float));
+    tubes->animationStage = calloc(tubeNum, sizeof(int));
+    tubes->wall = malloc(sizeof(tubes->wall[0])*tubeNum);
+    tubes->wallVertexNum = calloc(tubeNum, sizeof(int));
+    tubes->water = calloc(tubeNum, sizeof(Geometry));
+    tubes->detail = calloc(tubeNum, sizeof(float));
+    free(animationList);
+    free(animationIdx);
+    animationList = malloc(sizeof(animationList[0])*tubeNum);
+    animationIdx = malloc(sizeof(int)*tubeNum);
+    TUBE_NUM = tubeNum;
+    updateLayout();
+    tubes->grid = newTubeGrid(tubeNum, screenWidth, screenHeight, TUBE_WIDTH*GRID_CELL_TUBES);
+    initAnimations();
+    return tubes;
+}
+
+void freeTubes(Tubes* tubes){
+    free(tubes->contains);
+    free(tubes->rect);
+    free(tubes->angle);
+    free(tubes->animationStage);
+    free(tubes->wall);
+    free(tubes->wallVertexNum);
+    for(int i = 0; i < TUBE_NUM; i++) geometryFree(&tubes->water[i]);
+    free(tubes->water);
+    free(tubes->detail);
+    freeTubeGrid(tubes->grid);
+    free(tubes);
+}
+
+void initTube(Tubes* tubes, int idx, Rectangle rect, float angle, const Color* tubeColors){
+    tubes->rect[idx] = rect;
+    tubes->angle[idx] = angle;
+    indexTube(tubes, idx);
     for(int i = 0; i < MAX_TUBE_WATER; i++)
-        (*tube).contains[i] = tubeColors[i];
-    (*tube).animationStage = STILL;
-    // (*tube).animationStage = POURING;
+        tubes->contains[idx][i] = i < TUBE_CAPACITY ? tubeColors[i] : BLANK;
+    tubes->animationStage[idx] = STILL;
+    // tubes->animationStage[idx] = POURING;
 }
 
-void initTubes(Tube* tubes){
-    initTube(&tubes[0], (Rectangle){ 100.0, 150.0, TUBE_WIDTH, TUBE_HEIGHT }, 0.0, (Color[]){ BLUE, RED, BLUE, GREEN });
-    initTube(&tubes[1], (Rectangle){ 200.0, 150.0, TUBE_WIDTH, TUBE_HEIGHT }, 0.0, (Color[]){ GREEN, RED, RED, BLUE });
-    initTube(&tubes[2], (Rectangle){ 300.0, 150.0, TUBE_WIDTH, TUBE_HEIGHT }, 0.0, (Color[]){ GREEN, BLUE, GREEN, RED });
+void initTubes(Tubes* tubes){
+    setTubeCapacity(4);
+    initTube(tubes, 0, layoutTube(0), 0.0, (Color[]){ BLUE, RED, BLUE, GREEN });
+    initTube(tubes, 1, layoutTube(1), 0.0, (Color[]){ GREEN, RED, RED, BLUE });
+    initTube(tubes, 2, layoutTube(2), 0.0, (Color[]){ GREEN, BLUE, GREEN, RED });
     for(int i = 3; i < TUBE_NUM; i++)
-        initTube(&tubes[i], (Rectangle){ 100.0*(i+1), 150.0, TUBE_WIDTH, TUBE_HEIGHT }, 0.0, (Color[]){ BLANK, BLANK, BLANK, BLANK });
+        initTube(tubes, i, layoutTube(i), 0.0, (Color[]){ BLANK, BLANK, BLANK, BLANK });
 }
 
-void initGame(Tube* tubes){
-    // init animation settings
-    memset(animationList, 0, sizeof(animationList));
-    memset(animationIdx, 0, sizeof(animationIdx));
+void indexTube(Tubes* tubes, int idx){
+    // called whenever rect or angle of a tube changes: moves it in the hit testing grid
+    // and drops its wall triangles
+    tubeGridMove(tubes->grid, idx, tubeBounds(tubes->rect[idx], tubes->angle[idx]));
+    tubes->wallVertexNum[idx] = 0;
+}
+
+void indexTubes(Tubes* tubes, float width, float height){
+    // rebuild the grid for a new screen size
+    freeTubeGrid(tubes->grid);
+    tubes->grid = newTubeGrid(TUBE_NUM, width, height, TUBE_WIDTH*GRID_CELL_TUBES);
+    for(int i = 0; i < TUBE_NUM; i++) indexTube(tubes, i);
+}
+
+int tubeAt(Tubes* tubes, Vector2 pos){
+    // topmost tube under pos, -1 if none. only tubes sharing the grid cell are
+    // tested, their boxes first; higher indices are drawn last and win
+    const int* candidates;
+    int candidateNum = tubeGridQuery(tubes->grid, pos, &candidates), hit = -1;
+    for(int i = 0; i < candidateNum; i++){
+        int idx = candidates[i];
+        if(idx > hit && CheckCollisionPointRec(pos, tubes->grid->box[idx]) &&
+           insideTube(pos, tubes->rect[idx], tubes->angle[idx])) hit = idx;
+    }
+    return hit;
+}
+
+void initAnimations(void){
+    memset(animationList, 0, sizeof(animationList[0])*TUBE_NUM);
+    memset(animationIdx, 0, sizeof(int)*TUBE_NUM);
     for(int i = 0; i < TUBE_NUM; i++)
         for(int j = 1; j < MAX_FRAME_NUM; j++)
             animationList[i][j][POURING_TO] = -1;
+}
+
+void initGame(Tubes* tubes){
+    // init animation settings
+    initAnimations();
     // init tubes
     initTubes(tubes);
 }
 
-void drawWater(Tube* tubes, int idx){
+float* waveTable = NULL; // wave height at each screen column, see updateWaveTable
+int waveTableWidth = 0;
+int waveTableFrame = -1;
+
+void updateWaveTable(void){
+    // water surfaces wave with x and frame only: one table per frame for every tube
+    if(waveTableFrame == frame && waveTableWidth == screenWidth) return;
+    if(waveTableWidth != screenWidth){
+        waveTable = realloc(waveTable, sizeof(float)*(screenWidth+1));
+        waveTableWidth = screenWidth;
+    }
+    // the phase turns by the same angle every column: rotate a unit vector instead of calling sin
+    double step = WAVE_FREQUENCY/screenWidth, phase = frame*WAVE_SPEED;
+    double c = cos(step), sn = sin(step), re = cos(phase), im = sin(phase);
+    for(int x = 0; x <= screenWidth; x++){
+        waveTable[x] = WAVE_AMPLITUDE*im;
+        double next = re*c-im*sn;
+        im = re*sn+im*c;
+        re = next;
+    }
+    waveTableFrame = frame;
+}
+
+static float waveHeightAt(float x){
+    // interpolated between columns, off screen columns are computed
+    if(x < 0 || x >= waveTableWidth) return WAVE_AMPLITUDE*sin(x*WAVE_FREQUENCY/screenWidth+frame*WAVE_SPEED);
+    int i = (int)x;
+    float f = x-i;
+    return waveTable[i]*(1-f)+waveTable[i+1]*f;
+}
+
+typedef struct WaterRows {
+    // left and right ends of the water rows: the circle on both sides, or
+    // the circle on one side and a line through `point` on the other
+    Vector2 center;
+    float radius;
+    float side;         // circle side, 1 on the left, -1 on the right
+    bool line;
+    Vector2 point;
+    float slope;        // dx/dy of the line
+} WaterRows;
+
+static bool rowEnds(const WaterRows* rows, float y, float* x1, float* x2){
+    // false above and below the circle
+    float d = rows->radius*rows->radius-(y-rows->center.y)*(y-rows->center.y);
+    if(d < 0) return false;
+    *x1 = rows->center.x-rows->side*sqrtf(d);
+    *x2 = rows->line ? rows->point.x+rows->slope*(y-rows->point.y) : rows->center.x+sqrtf(d);
+    return true;
+}
+
+static void rowStrip(Geometry* geometry, const WaterRows* rows, float yStart, float yEnd, float step, Color color){
+    // fills [yStart, yEnd] with one quad per step rows
+    for(float y0 = yStart; y0 < yEnd; y0 += step){
+        float y1 = min(y0+step, yEnd), a0, b0, a1, b1;
+        bool top = rowEnds(rows, y0, &a0, &b0), bottom = rowEnds(rows, y1, &a1, &b1);
+        if(!top && !bottom) continue;
+        if(!top){ a0 = a1; b0 = b1; }
+        if(!bottom){ a1 = a0; b1 = b0; }
+        if(a0+a1 > b0+b1){ // counter-clockwise on screen, or it is culled
+            float t = a0; a0 = b0; b0 = t;
+            t = a1; a1 = b1; b1 = t;
+        }
+        geometryTriangle(geometry, (Vector2){ a0, y0 }, (Vector2){ a1, y1 }, (Vector2){ b0, y0 }, color);
+        geometryTriangle(geometry, (Vector2){ b0, y0 }, (Vector2){ a1, y1 }, (Vector2){ b1, y1 }, color);
+    }
+}
+
+static void waveStrip(Geometry* geometry, float xStart, float xEnd, float y, float step, Color color){
+    // wave crest over [xStart, xEnd] down to y+1, one quad per step columns
+    if(xEnd < xStart){
+        float x = xStart;
+        xStart = xEnd;
+        xEnd = x;
+    }
+    for(float x0 = xStart; x0 < xEnd; x0 += step){
+        float x1 = min(x0+step, xEnd);
+        Vector2 top0 = (Vector2){ x0, y-WAVE_AMPLITUDE+waveHeightAt(x0) }, top1 = (Vector2){ x1, y-WAVE_AMPLITUDE+waveHeightAt(x1) };
+        geometryTriangle(geometry, top0, (Vector2){ x0, y+1.0 }, top1, color);
+        geometryTriangle(geometry, top1, (Vector2){ x0, y+1.0 }, (Vector2){ x1, y+1.0 }, color);
+    }
+}
+
+void chooseDetail(Tubes* tubes){
+    // sample spacing of every tube's water: a fixed # of samples across the tube,
+    // more for moving tubes whose waves show; coarser everywhere past the frame budget
+    float samples = 0;
+    for(int i = 0; i < TUBE_NUM; i++){
+        float width = tubes->rect[i].width;
+        tubes->detail[i] = max(1.0, width/(animationIdx[i] > 0 ? DETAIL_MOVING_SAMPLES : DETAIL_STILL_SAMPLES));
+        samples += (width+tubes->rect[i].height)/tubes->detail[i];
+    }
+    if(samples > DETAIL_FRAME_SAMPLES)
+        for(int i = 0; i < TUBE_NUM; i++) tubes->detail[i] *= samples/DETAIL_FRAME_SAMPLES;
+}
+
+void buildWater(Tubes* tubes, int idx){
+    // water of one tube into tubes->water[idx], reads the wave table of this frame.
+    // draws nothing, so tubes can be built on several threads at once
+    Geometry* geometry = &tubes->water[idx];
+    geometryClear(geometry);
     // tube info
-    int s = 1-2*isPourLeft(tubes[idx].angle); // pour left -> -1, pour right -> 1
-    float rad = fabs(tubes[idx].angle*PI/180.0);
-    float radius = tubes[idx].rect.width/2.0-TUBE_THICKNESS;
-    float waterSurfaceLength = (tubes[idx].rect.width-TUBE_THICKNESS*2)/cos(rad);
-    int waterTotal = countWater(tubes[idx]);
+    int s = 1-2*isPourLeft(tubes->angle[idx]); // pour left -> -1, pour right -> 1
+    float rad = fabs(tubes->angle[idx]*PI/180.0);
+    float radius = tubes->rect[idx].width/2.0-TUBE_THICKNESS;
+    float waterSurfaceLength = (tubes->rect[idx].width-TUBE_THICKNESS*2)/cos(rad);
+    int waterTotal = countWater(tubes->contains[idx]);
     int pourCnt = animationList[idx][animationIdx[idx]][POUR_COUNT];
     // if(waterTotal == 0) return; // 
     if(waterTotal < 0){
@@ -153,36 +371,33 @@ void drawWater(Tube* tubes, int idx){
     }
 
     // bottom water ratio relative to other water colors
-    float eachWaterHeight = 1.0*(radius+TUBE_HEIGHT)*WATER_PERCENT/MAX_TUBE_WATER; // to ensure each water has same height
-    float bottomWaterRatioBegin = (1.0*TUBE_HEIGHT*WATER_PERCENT-eachWaterHeight*(MAX_TUBE_WATER-1))/eachWaterHeight;
+    float eachWaterHeight = 1.0*(radius+TUBE_HEIGHT)*WATER_PERCENT/TUBE_CAPACITY; // to ensure each water has same height
+    float bottomWaterRatioBegin = (1.0*TUBE_HEIGHT*WATER_PERCENT-eachWaterHeight*(TUBE_CAPACITY-1))/eachWaterHeight;
     float bottomWaterRatioEnd = 1.5;
     // printf("begin ratio: %f, end ratio: %f\n", bottomWaterRatioBegin, bottomWaterRatioEnd);
 
     // drawing info
-    float lineDensity = 1.0;    // pixel
-    float waveAmplitude = 2.0;  // pixel
-    float waveFrequency = 150.0/screenWidth;
-    float frameAnimationConstant = 0.1;
+    float lineDensity = tubes->detail[idx]; // pixels between two samples, see chooseDetail
 
     // ratios for determining point positions
-    float pourProcessRatio = fabs(tubes[idx].angle)/targetAngle[waterTotal-pourCnt];
+    float pourProcessRatio = fabs(tubes->angle[idx])/targetAngle[waterTotal-pourCnt];
     pourProcessRatio = waterLevelAnimation(pourProcessRatio, waterTotal); // from 0 (vertical) to 1 (Reaching the target angle)
     float bottomWaterRatio = (1-pourProcessRatio)*bottomWaterRatioBegin + pourProcessRatio*bottomWaterRatioEnd;
-    float curMaxWaterPosRatio = WATER_PERCENT*(bottomWaterRatio+waterTotal-1)/(bottomWaterRatio+MAX_TUBE_WATER-1); // for still case only
+    float curMaxWaterPosRatio = WATER_PERCENT*(bottomWaterRatio+waterTotal-1)/(bottomWaterRatio+TUBE_CAPACITY-1); // for still case only
     curMaxWaterPosRatio += pourProcessRatio*(1-curMaxWaterPosRatio); // make curMaxWaterPosRatio universal to tilt cases
-    // printTubeInfo(tubes[idx], idx);
+    // printTubeInfo(tubes, idx);
     // printf("pour process ratio: %f\n", pourProcessRatio);
     // printf("bottom water ratio: %f\n", bottomWaterRatio);
     // printf("current max water position ratio: %f\n", curMaxWaterPosRatio);
 
     // corner coordinates for inner side
-    Vector2 topLeft     = (Vector2){ tubes[idx].rect.x+TUBE_THICKNESS*cos(rad), tubes[idx].rect.y+TUBE_THICKNESS*sin(rad)*s },
-            topRight    = (Vector2){ tubes[idx].rect.x+(tubes[idx].rect.width-TUBE_THICKNESS)*cos(rad),
-                                     tubes[idx].rect.y+(tubes[idx].rect.width-TUBE_THICKNESS)*sin(rad)*s },
-            bottomLeft  = (Vector2){ tubes[idx].rect.x+TUBE_THICKNESS*cos(rad)-tubes[idx].rect.height*sin(rad)*s,
-                                     tubes[idx].rect.y+TUBE_THICKNESS*sin(rad)*s+tubes[idx].rect.height*cos(rad) },
-            bottomRight = (Vector2){ tubes[idx].rect.x+(tubes[idx].rect.width-TUBE_THICKNESS)*cos(rad)-tubes[idx].rect.height*sin(rad)*s,
-                                     tubes[idx].rect.y+(tubes[idx].rect.width-TUBE_THICKNESS)*sin(rad)*s+tubes[idx].rect.height*cos(rad) };
+    Vector2 topLeft     = (Vector2){ tubes->rect[idx].x+TUBE_THICKNESS*cos(rad), tubes->rect[idx].y+TUBE_THICKNESS*sin(rad)*s },
+            topRight    = (Vector2){ tubes->rect[idx].x+(tubes->rect[idx].width-TUBE_THICKNESS)*cos(rad),
+                                     tubes->rect[idx].y+(tubes->rect[idx].width-TUBE_THICKNESS)*sin(rad)*s },
+            bottomLeft  = (Vector2){ tubes->rect[idx].x+TUBE_THICKNESS*cos(rad)-tubes->rect[idx].height*sin(rad)*s,
+                                     tubes->rect[idx].y+TUBE_THICKNESS*sin(rad)*s+tubes->rect[idx].height*cos(rad) },
+            bottomRight = (Vector2){ tubes->rect[idx].x+(tubes->rect[idx].width-TUBE_THICKNESS)*cos(rad)-tubes->rect[idx].height*sin(rad)*s,
+                                     tubes->rect[idx].y+(tubes->rect[idx].width-TUBE_THICKNESS)*sin(rad)*s+tubes->rect[idx].height*cos(rad) };
     Vector2 semiCircleCenter = (Vector2){ bottomLeft.x+radius*cos(rad), bottomLeft.y+radius*sin(rad)*s };
 
     Vector2 bottom      = s < 1 ? bottomLeft  : bottomRight,
@@ -196,32 +411,32 @@ void drawWater(Tube* tubes, int idx){
     // DrawCircleV(fullWaterPos, 10, ORANGE);
 
     // add plot for water fall
-    if(tubes[idx].animationStage == POURING){
+    if(tubes->animationStage[idx] == POURING){
         int to = animationList[idx][animationIdx[idx]][POURING_TO];
-        int ptWaterCnt = countWater(tubes[to]); // pouring to water count
-        float waterLevelRatio = (bottomWaterRatioBegin+(float)ptWaterCnt-1.0)/(bottomWaterRatioBegin+(float)(MAX_TUBE_WATER-1));
+        int ptWaterCnt = countWater(tubes->contains[to]); // pouring to water count
+        float waterLevelRatio = (bottomWaterRatioBegin+(float)ptWaterCnt-1.0)/(bottomWaterRatioBegin+(float)(TUBE_CAPACITY-1));
 
-        float fullWaterLevel_y = (tubes[to].rect.y+tubes[to].rect.height)*(1-WATER_PERCENT) + tubes[to].rect.y*(WATER_PERCENT);
-        float curWaterLevel_y = ptWaterCnt == 0 ? tubes[to].rect.y+tubes[to].rect.height+radius
-                                : fullWaterLevel_y*waterLevelRatio+(tubes[to].rect.y+tubes[to].rect.height)*(1-waterLevelRatio);
+        float fullWaterLevel_y = (tubes->rect[to].y+tubes->rect[to].height)*(1-WATER_PERCENT) + tubes->rect[to].y*(WATER_PERCENT);
+        float curWaterLevel_y = ptWaterCnt == 0 ? tubes->rect[to].y+tubes->rect[to].height+radius
+                                : fullWaterLevel_y*waterLevelRatio+(tubes->rect[to].y+tubes->rect[to].height)*(1-waterLevelRatio);
 
         Vector2 pourPos = s > 0 ? topRight : topLeft;
         float waterHeight = curWaterLevel_y-pourPos.y;
         // printf("water height: %f\n", waterHeight);
 
         // draw falling water column
-        DrawRectangleV(pourPos, (Vector2){ TUBE_THICKNESS, waterHeight }, tubes[idx].contains[waterTotal-1]);
+        geometryRectangle(geometry, pourPos, (Vector2){ TUBE_THICKNESS, waterHeight }, tubes->contains[idx][waterTotal-1]);
     }
 
     // check if this tube is being poured
     int beingPoured = 0;
     Color pouredCol = BLANK;
     for(int i = 0; i < TUBE_NUM; i++){
-        if(animationIdx[i] > 0 && tubes[i].animationStage == POURING && (int)animationList[i][animationIdx[i]][POURING_TO] == idx){
+        if(animationIdx[i] > 0 && tubes->animationStage[i] == POURING && (int)animationList[i][animationIdx[i]][POURING_TO] == idx){
             if(beingPoured == 0){
                 beingPoured = 1;
-                pouredCol = tubes[i].contains[countWater(tubes[i])-1];
-            } else if(!sameColor(tubes[i].contains[countWater(tubes[i])-1], pouredCol)){
+                pouredCol = tubes->contains[i][countWater(tubes->contains[i])-1];
+            } else if(!sameColor(tubes->contains[i][countWater(tubes->contains[i])-1], pouredCol)){
                 printf("Error: Inconsistent poured color at tube: %d", idx);
                 exit(-1);
             }
@@ -231,18 +446,18 @@ void drawWater(Tube* tubes, int idx){
     if(beingPoured){
         // printf("Tube %d is being poured\n", idx);
         float pourAmount = getPouredAmount(tubes, idx);
-        float waterLowLevelRatio = (bottomWaterRatio+(float)waterTotal-1.0)/(bottomWaterRatio+(float)(MAX_TUBE_WATER-1));
+        float waterLowLevelRatio = (bottomWaterRatio+(float)waterTotal-1.0)/(bottomWaterRatio+(float)(TUBE_CAPACITY-1));
         // printf("pour amount: %f\n", pourAmount);
 
         float lowPos_y;
         Vector2 waterPos;
         if(waterTotal == 0){ // waterLowLevelRatio < 0
-            float waterRatio = pourAmount/MAX_TUBE_WATER;
+            float waterRatio = pourAmount/TUBE_CAPACITY;
             // printf("water ratio: %f\n", waterRatio);
             lowPos_y = bottom.y+radius;
             waterPos = (Vector2){ topLeft.x, (bottom.y+radius)*(1-waterRatio)+fullWaterPos.y*waterRatio };
         } else {
-            float ptWaterLevelRatio = (bottomWaterRatio+waterTotal-1+pourAmount)/(bottomWaterRatio+(float)(MAX_TUBE_WATER-1));
+            float ptWaterLevelRatio = (bottomWaterRatio+waterTotal-1+pourAmount)/(bottomWaterRatio+(float)(TUBE_CAPACITY-1));
             lowPos_y = fullWaterPos.y*waterLowLevelRatio+bottom.y*(1-waterLowLevelRatio);
             waterPos = (Vector2){ topLeft.x, fullWaterPos.y*ptWaterLevelRatio+bottom.y*(1-ptWaterLevelRatio) };
         }
@@ -250,49 +465,33 @@ void drawWater(Tube* tubes, int idx){
         // draw poured water from the water fall and the corresponding wave
         if(waterPos.y < semiCircleCenter.y){ // if above semi circle
             // wave
-            for(float pixel_x = waterPos.x; pixel_x < waterPos.x+2*radius; pixel_x += lineDensity){
-                float waveHeight = waveAmplitude*sin(pixel_x*waveFrequency+frame*frameAnimationConstant);
-                Vector2 waveStart = (Vector2){ pixel_x, waterPos.y-waveAmplitude+waveHeight },
-                        waveEnd   = (Vector2){ pixel_x, waterPos.y+1.0 };
-                DrawLineV(waveStart, waveEnd, pouredCol);
-            }
+            waveStrip(geometry, waterPos.x, waterPos.x+2*radius, waterPos.y, lineDensity, pouredCol);
             // water fill
             if(waterTotal == 0){
-                DrawRectangleV((Vector2){ waterPos.x, waterPos.y }, (Vector2){ radius*2, bottom.y-waterPos.y }, pouredCol);
-                DrawCircleSector(semiCircleCenter, radius, 0.0, 180.0, 1, pouredCol);
+                geometryRectangle(geometry, (Vector2){ waterPos.x, waterPos.y }, (Vector2){ radius*2, bottom.y-waterPos.y }, pouredCol);
+                geometrySector(geometry, semiCircleCenter, radius, 0.0, 180.0, max(2*radius/lineDensity, 4), pouredCol);
             } else {
-                DrawRectangleV((Vector2){ waterPos.x, waterPos.y }, (Vector2){ radius*2, lowPos_y-waterPos.y }, pouredCol);
+                geometryRectangle(geometry, (Vector2){ waterPos.x, waterPos.y }, (Vector2){ radius*2, lowPos_y-waterPos.y }, pouredCol);
             }
         } else {
             // wave
             float pixel_start = waterPos.x+radius-sqrtf(radius*radius-(semiCircleCenter.y-waterPos.y)*(semiCircleCenter.y-waterPos.y));
             float pixel_end   = waterPos.x+radius+sqrtf(radius*radius-(semiCircleCenter.y-waterPos.y)*(semiCircleCenter.y-waterPos.y));
-            for(float pixel_x = pixel_start; pixel_x < pixel_end; pixel_x += lineDensity){
-                float waveHeight = waveAmplitude*sin(pixel_x*waveFrequency+frame*frameAnimationConstant);
-                Vector2 waveStart = (Vector2){ pixel_x, waterPos.y-waveAmplitude+waveHeight },
-                        waveEnd   = (Vector2){ pixel_x, waterPos.y+1.0 };
-                DrawLineV(waveStart, waveEnd, pouredCol);
-                // DrawCircleV(waveStart, 5, ORANGE);
-                // DrawCircleV(waveEnd, 5, PURPLE);
-            }
+            waveStrip(geometry, pixel_start, pixel_end, waterPos.y, lineDensity, pouredCol);
             // water fill
-            for(int pixel_y = waterPos.y; pixel_y < semiCircleCenter.y+radius; pixel_y += lineDensity){
-                float pixel_start = waterPos.x+radius-sqrtf(radius*radius-(semiCircleCenter.y-pixel_y)*(semiCircleCenter.y-pixel_y));
-                float pixel_end   = waterPos.x+radius+sqrtf(radius*radius-(semiCircleCenter.y-pixel_y)*(semiCircleCenter.y-pixel_y));
-                DrawLineV((Vector2){ pixel_start, pixel_y },
-                          (Vector2){ pixel_end, pixel_y }, pouredCol);
-            }
+            WaterRows rows = { .center = (Vector2){ waterPos.x+radius, semiCircleCenter.y }, .radius = radius, .side = 1 };
+            rowStrip(geometry, &rows, waterPos.y, semiCircleCenter.y+radius, lineDensity, pouredCol);
         }
     }
 
     for(int j = waterTotal-1; j >= 0; j -= (pourCnt && j == waterTotal-1) ? pourCnt : 1){
-        Color col = tubes[idx].contains[j];
+        Color col = tubes->contains[idx][j];
         Vector2 startPos, endPos;
         float startRatio, endRatio;
 
-        if(tubes[idx].animationStage == POURING){
+        if(tubes->animationStage[idx] == POURING){
             // pouring process ratio from 0 (just reach start pouring angle) to 1 (pouring done)
-            float pouringProcessRatio = (fabs(tubes[idx].angle)-targetAngle[waterTotal])
+            float pouringProcessRatio = (fabs(tubes->angle[idx])-targetAngle[waterTotal])
                                         /(targetAngle[waterTotal-pourCnt]-targetAngle[waterTotal]);
             float pourAmount = pourCnt*pouringProcessRatio;
             if(j == waterTotal-1){ // for the top water
@@ -303,8 +502,8 @@ void drawWater(Tube* tubes, int idx){
                 startRatio = (bottomWaterRatio+(float)j)/(bottomWaterRatio+(float)(waterTotal-1)-pourAmount);
                 endRatio = (bottomWaterRatio+(float)j-1)/(bottomWaterRatio+(float)(waterTotal-1)-pourAmount);
             }
-        } else if(tubes[idx].animationStage == MOVE_BACK){
-            float moveBackProcessRatio = 1-(fabs(tubes[idx].angle)/targetAngle[waterTotal]);
+        } else if(tubes->animationStage[idx] == MOVE_BACK){
+            float moveBackProcessRatio = 1-(fabs(tubes->angle[idx])/targetAngle[waterTotal]);
             if(j == waterTotal-1){ // for the top water
                 startRatio = 1;
                 endRatio = (bottomWaterRatio+(float)j-1)/(bottomWaterRatio+(float)(waterTotal-1));
@@ -313,7 +512,7 @@ void drawWater(Tube* tubes, int idx){
                 startRatio = (bottomWaterRatio+(float)j)/(bottomWaterRatio+(float)(waterTotal-1));
                 endRatio = (bottomWaterRatio+(float)j-1)/(bottomWaterRatio+(float)(waterTotal-1));
             }
-        } else if(tubes[idx].animationStage == MOVE_TO){
+        } else if(tubes->animationStage[idx] == MOVE_TO){
             if(j == waterTotal-1){ // for the top water
                 startRatio = (bottomWaterRatio+(float)j)/(bottomWaterRatio+(float)(waterTotal-1));
                 endRatio = (bottomWaterRatio+(float)j-pourCnt)/(bottomWaterRatio+(float)(waterTotal-1));
@@ -338,20 +537,16 @@ void drawWater(Tube* tubes, int idx){
         if(startPos.y < top.y) startPos = top;
 
         // add water fluctuation for the top color
-        if(j == waterTotal-1 && (tubes[idx].animationStage == MOVE_TO || tubes[idx].animationStage == POURING)){
+        if(j == waterTotal-1 && (tubes->animationStage[idx] == MOVE_TO || tubes->animationStage[idx] == POURING)){
             if(waterTotal == 1 || (waterTotal > 1 && endPos.y > startPos.y)){
                 // printf("Drawing wave\n");
-                float pixel_start, waveHeight;
+                float pixel_start;
                 if(startPos.y < bottomOppo.y){
                     pixel_start = startPos.x-s*waterSurfaceLength;
                 } else {
                     pixel_start = semiCircleCenter.x-s*sqrtf(radius*radius-(startPos.y-semiCircleCenter.y)*(startPos.y-semiCircleCenter.y));
                 }
-                for(float pixel_x = pixel_start; s*pixel_x < s*startPos.x; pixel_x += s*lineDensity){
-                    waveHeight = waveAmplitude*sin(pixel_x*waveFrequency+frame*frameAnimationConstant);
-                    DrawLineV((Vector2){ pixel_x, startPos.y-waveAmplitude+waveHeight },
-                              (Vector2){ pixel_x, startPos.y+1.0 }, col);
-                }
+                waveStrip(geometry, pixel_start, startPos.x, startPos.y, lineDensity, col);
             }
         }
         
@@ -360,81 +555,127 @@ void drawWater(Tube* tubes, int idx){
             if(startPos.y < bottomOppo.y){
                 Vector2 v1 = s > 0 ? (Vector2){ startPos.x-s*waterSurfaceLength, startPos.y } : startPos;
                 Vector2 v2 = s > 0 ? startPos : (Vector2){ startPos.x-s*waterSurfaceLength, startPos.y };
-                DrawTriangle(v1, bottomOppo, v2, col);
+                geometryTriangle(geometry, v1, bottomOppo, v2, col);
                 v1 = s < 0 ? (Vector2){ bottomOppo.x+s*waterSurfaceLength, bottomOppo.y } : bottomOppo;
                 v2 = s < 0 ? bottomOppo : (Vector2){ bottomOppo.x+s*waterSurfaceLength, bottomOppo.y };
-                DrawTriangle(v1, v2, startPos, col);
-            }
-            for(float pixel_y = startPos.y; pixel_y < bottom.y; pixel_y += lineDensity){
-                float pixel_x1 = semiCircleCenter.x-s*sqrtf(radius*radius-(pixel_y-semiCircleCenter.y)*(pixel_y-semiCircleCenter.y));
-                float pixel_x2 = startPos.x+(startPos.x-bottom.x)/(startPos.y-bottom.y)*(pixel_y-startPos.y);
-                DrawLineV((Vector2){ pixel_x1, pixel_y }, (Vector2){ pixel_x2, pixel_y }, col);
-            }
-            for(float pixel_y = bottom.y; pixel_y < semiCircleCenter.y+radius; pixel_y += lineDensity){
-                float pixel_x1 = semiCircleCenter.x-sqrtf(radius*radius-(pixel_y-semiCircleCenter.y)*(pixel_y-semiCircleCenter.y));
-                float pixel_x2 = semiCircleCenter.x+sqrtf(radius*radius-(pixel_y-semiCircleCenter.y)*(pixel_y-semiCircleCenter.y));
-                DrawLineV((Vector2){ pixel_x1, pixel_y }, (Vector2){ pixel_x2, pixel_y }, col);
+                geometryTriangle(geometry, v1, v2, startPos, col);
             }
+            WaterRows side = { .center = semiCircleCenter, .radius = radius, .side = s, .line = true, .point = startPos,
+                               .slope = (startPos.x-bottom.x)/(startPos.y-bottom.y) };
+            rowStrip(geometry, &side, startPos.y, bottom.y, lineDensity, col);
+            WaterRows round = { .center = semiCircleCenter, .radius = radius, .side = 1 };
+            rowStrip(geometry, &round, bottom.y, semiCircleCenter.y+radius, lineDensity, col);
         } else {
             // DrawCircleV(endPos, 5, ORANGE);
             if(endPos.y < bottomOppo.y){
                 Vector2 v1 = s > 0 ? (Vector2){ startPos.x-s*waterSurfaceLength, startPos.y } : startPos;
                 Vector2 v2 = s > 0 ? startPos : (Vector2){ startPos.x-s*waterSurfaceLength, startPos.y };
-                DrawTriangle(v1, endPos, v2, col);
+                geometryTriangle(geometry, v1, endPos, v2, col);
                 v1 = s > 0 ? (Vector2){ endPos.x-s*waterSurfaceLength, endPos.y } : endPos;
                 v2 = s > 0 ? endPos : (Vector2){ endPos.x-s*waterSurfaceLength, endPos.y };
-                DrawTriangle((Vector2){ startPos.x-s*waterSurfaceLength, startPos.y }, v1, v2, col);
+                geometryTriangle(geometry, (Vector2){ startPos.x-s*waterSurfaceLength, startPos.y }, v1, v2, col);
             } else { // endPos.y > bottomOppo.y
                 if(startPos.y < bottomOppo.y){
                     Vector2 v1 = s > 0 ? (Vector2){ startPos.x-s*waterSurfaceLength, startPos.y } : startPos;
                     Vector2 v2 = s > 0 ? startPos : (Vector2){ startPos.x-s*waterSurfaceLength, startPos.y };
-                    DrawTriangle(v1, bottomOppo, v2, col);
+                    geometryTriangle(geometry, v1, bottomOppo, v2, col);
                     v1 = s < 0 ? (Vector2){ bottomOppo.x+s*waterSurfaceLength, bottomOppo.y } : bottomOppo;
                     v2 = s < 0 ? bottomOppo : (Vector2){ bottomOppo.x+s*waterSurfaceLength, bottomOppo.y };
-                    DrawTriangle(v1, v2, startPos, col);
-                }
-                for(float pixel_y = startPos.y; pixel_y < endPos.y; pixel_y += lineDensity){
-                    float pixel_x1 = semiCircleCenter.x-s*sqrtf(radius*radius-(pixel_y-semiCircleCenter.y)*(pixel_y-semiCircleCenter.y));
-                    float pixel_x2 = startPos.x+(startPos.x-endPos.x)/(startPos.y-endPos.y)*(pixel_y-startPos.y);
-                    DrawLineV((Vector2){ pixel_x1, pixel_y }, (Vector2){ pixel_x2, pixel_y }, col);
+                    geometryTriangle(geometry, v1, v2, startPos, col);
                 }
+                WaterRows side = { .center = semiCircleCenter, .radius = radius, .side = s, .line = true, .point = startPos,
+                                   .slope = (startPos.x-endPos.x)/(startPos.y-endPos.y) };
+                rowStrip(geometry, &side, startPos.y, endPos.y, lineDensity, col);
             }
         }
     }
 }
 
-void drawTubeWall(Tube* tubes, int idx){
-    DrawRectanglePro((Rectangle){ tubes[idx].rect.x, tubes[idx].rect.y, TUBE_THICKNESS, tubes[idx].rect.height },
-                     (Vector2){ 0.0, 0.0 }, tubes[idx].angle, TUBE_WALL_COLOR);
-    DrawRectanglePro((Rectangle){ tubes[idx].rect.x+(tubes[idx].rect.width-TUBE_THICKNESS)*cos(tubes[idx].angle*PI/180.0),
-                                  tubes[idx].rect.y+(tubes[idx].rect.width-TUBE_THICKNESS)*sin(tubes[idx].angle*PI/180.0),
-                                  TUBE_THICKNESS,
-                                  tubes[idx].rect.height },
-                     (Vector2){ 0.0, 0.0 }, tubes[idx].angle, TUBE_WALL_COLOR);
-    DrawRing((Vector2){ tubes[idx].rect.x+tubes[idx].rect.width/2*cos(tubes[idx].angle*PI/180.0)-tubes[idx].rect.height*sin(tubes[idx].angle*PI/180.0),
-                        tubes[idx].rect.y+tubes[idx].rect.width/2*sin(tubes[idx].angle*PI/180.0)+tubes[idx].rect.height*cos(tubes[idx].angle*PI/180.0) },
-             tubes[idx].rect.width/2, tubes[idx].rect.width/2-TUBE_THICKNESS,
-             tubes[idx].angle, tubes[idx].angle+180.0, 1, TUBE_WALL_COLOR);
+static void wallQuad(Vector2* v, float x, float y, float width, float height, float rad){
+    // rectangle rotated around its top left corner, same corners as DrawRectanglePro
+    Vector2 topLeft     = (Vector2){ x, y },
+            topRight    = (Vector2){ x+width*cos(rad), y+width*sin(rad) },
+            bottomLeft  = (Vector2){ x-height*sin(rad), y+height*cos(rad) },
+            bottomRight = (Vector2){ x+width*cos(rad)-height*sin(rad), y+width*sin(rad)+height*cos(rad) };
+    v[0] = topLeft; v[1] = bottomLeft; v[2] = topRight;
+    v[3] = topRight; v[4] = bottomLeft; v[5] = bottomRight;
 }
 
-void drawTubes(Tube* tubes){
-    // plot still tubes
-    for(int i = 0; i < TUBE_NUM; i++){
-        if(animationIdx[i] == 0){
-            drawWater(tubes, i);
-            drawTubeWall(tubes, i);
-        }
+int tubeWall(Tubes* tubes, int idx){
+    // two side walls and the half ring at the bottom as triangles, kept until the tube moves.
+    // returns the # of vertices
+    if(tubes->wallVertexNum[idx] > 0) return tubes->wallVertexNum[idx];
+    Rectangle rect = tubes->rect[idx];
+    float rad = tubes->angle[idx]*PI/180.0;
+    Vector2* v = tubes->wall[idx];
+    wallQuad(v, rect.x, rect.y, TUBE_THICKNESS, rect.height, rad);
+    wallQuad(v+6, rect.x+(rect.width-TUBE_THICKNESS)*cos(rad), rect.y+(rect.width-TUBE_THICKNESS)*sin(rad),
+             TUBE_THICKNESS, rect.height, rad);
+    // as many segments as DrawRing picks for this radius
+    float outer = rect.width/2, inner = rect.width/2-TUBE_THICKNESS;
+    Vector2 center = (Vector2){ rect.x+outer*cos(rad)-rect.height*sin(rad), rect.y+outer*sin(rad)+rect.height*cos(rad) };
+    float th = acosf(2*powf(1-0.5/max(outer, 1.0), 2)-1);
+    int segments = min(max((int)ceilf(PI/th), 4), WALL_RING_SEGMENTS);
+    Vector2* r = v+12;
+    for(int i = 0; i < segments; i++){
+        float a0 = rad+PI*i/segments, a1 = rad+PI*(i+1)/segments;
+        Vector2 outer0 = (Vector2){ center.x+cos(a0)*outer, center.y+sin(a0)*outer },
+                inner0 = (Vector2){ center.x+cos(a0)*inner, center.y+sin(a0)*inner },
+                outer1 = (Vector2){ center.x+cos(a1)*outer, center.y+sin(a1)*outer },
+                inner1 = (Vector2){ center.x+cos(a1)*inner, center.y+sin(a1)*inner };
+        r[0] = outer0; r[1] = inner0; r[2] = inner1;
+        r[3] = outer1; r[4] = outer0; r[5] = inner1;
+        r += 6;
     }
-    // plot moving tubes
+    return tubes->wallVertexNum[idx] = 12+6*segments;
+}
+
+static void addWall(Tubes* tubes, int idx){
+    // vertices of one built wall into the open rlgl batch, flushed first if they do not fit
+    int vertexNum = tubes->wallVertexNum[idx];
+    rlCheckRenderBatchLimit(vertexNum);
+    for(int i = 0; i < vertexNum; i++) rlVertex2f(tubes->wall[idx][i].x, tubes->wall[idx][i].y);
+}
+
+static void buildTube(void* context, int idx){
+    Tubes* tubes = context;
+    PERF_BEGIN(PERF_WATER);
+    buildWater(tubes, idx);
+    PERF_END(PERF_WATER);
+    tubeWall(tubes, idx);
+}
+
+void drawTubes(Tubes* tubes){
+    // geometry of every tube first, on worker threads for larger boards; then only
+    // submission here. still tubes never overlap: all their water first, then every
+    // wall in one draw. moving tubes may cover each other and go one by one on top
+    TRACE_BEGIN("geometry");
+    updateWaveTable();
+    chooseDetail(tubes);
+    if(TUBE_NUM >= GEOMETRY_PARALLEL_MIN) parallelFor(TUBE_NUM, buildTube, tubes);
+    else for(int i = 0; i < TUBE_NUM; i++) buildTube(tubes, i);
+    TRACE_END("geometry");
+    TRACE_BEGIN("submit");
+    for(int i = 0; i < TUBE_NUM; i++)
+        if(animationIdx[i] == 0) geometryDraw(&tubes->water[i]);
+    rlBegin(RL_TRIANGLES);
+    rlColor4ub(TUBE_WALL_COLOR.r, TUBE_WALL_COLOR.g, TUBE_WALL_COLOR.b, TUBE_WALL_COLOR.a);
+    for(int i = 0; i < TUBE_NUM; i++)
+        if(animationIdx[i] == 0) addWall(tubes, i);
+    rlEnd();
     for(int i = 0; i < TUBE_NUM; i++){
         if(animationIdx[i] > 0){
-            drawWater(tubes, i);
-            drawTubeWall(tubes, i);
+            geometryDraw(&tubes->water[i]);
+            rlBegin(RL_TRIANGLES);
+            rlColor4ub(TUBE_WALL_COLOR.r, TUBE_WALL_COLOR.g, TUBE_WALL_COLOR.b, TUBE_WALL_COLOR.a);
+            addWall(tubes, i);
+            rlEnd();
         }
     }
+    TRACE_END("submit");
 }
 
-void selectTube(Tube* tubes, int tubeIdx){
+void selectTube(Tubes* tubes, int tubeIdx){
     // if(animationIdx[tubeIdx] > 0) return;
     selectedTube = tubeIdx;
     // add move up animation
@@ -442,16 +683,16 @@ void selectTube(Tube* tubes, int tubeIdx){
     float offset = HEIGHT_SELECT/FRAME_SELECT;
     animationIdx[tubeIdx] = FRAME_SELECT;
     for(int i = 1; i < FRAME_SELECT; i++){
-        animationList[tubeIdx][idx][RECT_X] = tubes[tubeIdx].rect.x;
-        animationList[tubeIdx][idx][RECT_Y] = tubes[tubeIdx].rect.y-i*offset;
+        animationList[tubeIdx][idx][RECT_X] = tubes->rect[tubeIdx].x;
+        animationList[tubeIdx][idx][RECT_Y] = tubes->rect[tubeIdx].y-i*offset;
         animationList[tubeIdx][idx][ANGLE] = 0.0;
         animationList[tubeIdx][idx][ANIMATION_STAGE] = SELECT_PRE;
         animationList[tubeIdx][idx][POURING_TO] = -1;
         animationList[tubeIdx][idx][POUR_COUNT] = 0;
         idx--;
     }
-    animationList[tubeIdx][1][RECT_X] = tubes[tubeIdx].rect.x;
-    animationList[tubeIdx][1][RECT_Y] = tubes[tubeIdx].rect.y-FRAME_SELECT*offset;
+    animationList[tubeIdx][1][RECT_X] = tubes->rect[tubeIdx].x;
+    animationList[tubeIdx][1][RECT_Y] = tubes->rect[tubeIdx].y-FRAME_SELECT*offset;
     animationList[tubeIdx][1][ANGLE] = 0.0;
     animationList[tubeIdx][1][ANIMATION_STAGE] = SELECT_DONE;
     animationList[tubeIdx][1][POURING_TO] = -1;
@@ -460,7 +701,7 @@ void selectTube(Tube* tubes, int tubeIdx){
     //     printAnimationInfo(animationList[tubeIdx][i]);
 }
 
-void deselectTube(Tube* tubes, int tubeIdx){
+void deselectTube(Tubes* tubes, int tubeIdx){
     // if(animationIdx[tubeIdx] > 0) return;
     float offset = HEIGHT_SELECT/FRAME_SELECT;
     int idx = FRAME_SELECT-animationIdx[tubeIdx];
@@ -468,71 +709,84 @@ void deselectTube(Tube* tubes, int tubeIdx){
     memset(animationList[tubeIdx], 0, sizeof(animationList[tubeIdx]));
     animationIdx[tubeIdx] = idx;
     for(int i = idx; i > 1; i--){
-        animationList[tubeIdx][i][RECT_X] = tubes[tubeIdx].rect.x;
-        animationList[tubeIdx][i][RECT_Y] = tubes[tubeIdx].rect.y+(idx-i+1)*offset;
+        animationList[tubeIdx][i][RECT_X] = tubes->rect[tubeIdx].x;
+        animationList[tubeIdx][i][RECT_Y] = tubes->rect[tubeIdx].y+(idx-i+1)*offset;
         animationList[tubeIdx][i][ANGLE] = 0.0;
         animationList[tubeIdx][i][ANIMATION_STAGE] = SELECT_PRE;
     }
-    animationList[tubeIdx][1][RECT_X] = tubes[tubeIdx].rect.x;
-    animationList[tubeIdx][1][RECT_Y] = tubes[tubeIdx].rect.y+idx*offset;
+    animationList[tubeIdx][1][RECT_X] = tubes->rect[tubeIdx].x;
+    animationList[tubeIdx][1][RECT_Y] = tubes->rect[tubeIdx].y+idx*offset;
     animationList[tubeIdx][1][ANGLE] = 0.0;
     animationList[tubeIdx][1][ANIMATION_STAGE] = STILL;
     // for(int i = 1; i <= idx; i++)
     //     printAnimationInfo(animationList[tubeIdx][i]);
 }
 
-bool checkPour(Tube* tubes, int from, int to){
-    // printf("checking pour:\n");
-    // printTubeInfo(tubes[from], from);
-    // printTubeInfo(tubes[to], to);
-    if(tubes[from].animationStage != SELECT_PRE && tubes[from].animationStage != SELECT_DONE)
-        return false;
-    if(tubes[to].animationStage != STILL)
-        return false;
-    // if other tubes are pouring, check the pouring condition
-    int curWaterTotal = countWater(tubes[to]), pourWaterTotal = 0;
+static int incomingWater(Tubes* tubes, int to, Color* top){
+    // units poured toward `to` that have not landed yet, they stay in their source until
+    // transferWater. top becomes the color `to` will have on top once they land
+    int incoming = 0;
+    int curWaterTotal = countWater(tubes->contains[to]);
+    *top = curWaterTotal > 0 ? tubes->contains[to][curWaterTotal-1] : BLANK;
     for(int i = 0; i < TUBE_NUM; i++){
-        if(i == from || i == to) continue;
-        if(animationIdx[i] > 0 && tubes[i].animationStage == POURING && animationList[i][animationIdx[i]][POURING_TO] == to)
-            pourWaterTotal += (int)animationList[i][animationIdx[i]][POUR_COUNT];
+        int idx = animationIdx[i];
+        if(i == to || idx == 0 || animationList[i][idx][POURING_TO] != to) continue;
+        int stage = animationList[i][idx][ANIMATION_STAGE];
+        if(stage != MOVE_TO && stage != POURING && !(stage == MOVE_BACK && animationList[i][idx+1][ANIMATION_STAGE] == POURING))
+            continue;
+        incoming += (int)animationList[i][idx][POUR_COUNT];
+        *top = tubes->contains[i][countWater(tubes->contains[i])-1];
     }
-    int pourCnt = countWater(tubes[from]);
-    if(curWaterTotal == MAX_TUBE_WATER || pourCnt == 0)
+    return incoming;
+}
+
+bool checkPour(Tubes* tubes, int from, int to){
+    // printf("checking pour:\n");
+    // printTubeInfo(tubes, from);
+    // printTubeInfo(tubes, to);
+    if(tubes->animationStage[from] != SELECT_PRE && tubes->animationStage[from] != SELECT_DONE)
         return false;
-    if(curWaterTotal > 0 && !sameColor(tubes[from].contains[pourCnt-1], tubes[to].contains[curWaterTotal-1]))
+    if(tubes->animationStage[to] != STILL)
         return false;
-    return curWaterTotal+pourWaterTotal < MAX_TUBE_WATER;
+    // water other tubes are still pouring into `to` counts as already there
+    Color top;
+    int curWaterTotal = countWater(tubes->contains[to]), pourWaterTotal = incomingWater(tubes, to, &top);
+    int pourCnt = countWater(tubes->contains[from]);
+    if(curWaterTotal+pourWaterTotal >= TUBE_CAPACITY || pourCnt == 0)
+        return false;
+    return emptyColor(top) || sameColor(tubes->contains[from][pourCnt-1], top);
 }
 
-void pour(Tube* tubes, int from, int to){
+int pour(Tubes* tubes, int from, int to){
     // if(animationIdx[from] > 0) return;
-    int c1 = countWater(tubes[from]), c2 = countWater(tubes[to]);
+    int c1 = countWater(tubes->contains[from]), c2 = countWater(tubes->contains[to]);
     float tarX, tarY, fullX, fullY, tarAngle, fullAngle;
     int pourCnt = 0;
     if(c2 == 0){
-        for(int i = c1-2; i >= 0 && sameColor(tubes[from].contains[i], tubes[from].contains[c1-1]); i--)
+        for(int i = c1-2; i >= 0 && sameColor(tubes->contains[from][i], tubes->contains[from][c1-1]); i--)
             pourCnt++;
         pourCnt++;
     } else {
-        for(int i = c1-1; i >= 0 && sameColor(tubes[from].contains[i], tubes[to].contains[c2-1]); i--)
+        for(int i = c1-1; i >= 0 && sameColor(tubes->contains[from][i], tubes->contains[to][c2-1]); i--)
             pourCnt++;
     }
-    pourCnt = min(pourCnt, MAX_TUBE_WATER-c2);
-    bool pourRight = tubes[from].rect.x < tubes[to].rect.x;
+    Color top;
+    pourCnt = min(pourCnt, TUBE_CAPACITY-c2-incomingWater(tubes, to, &top));
+    bool pourRight = tubes->rect[from].x < tubes->rect[to].x;
     if(pourRight){ // pour right
         tarAngle = targetAngle[c1-pourCnt];
-        tarX = tubes[to].rect.x+tubes[to].rect.width/2.0-tubes[from].rect.width*cos(tarAngle*PI/180.0);
-        tarY = tubes[to].rect.y-HEIGHT_POUR-tubes[from].rect.width*sin(tarAngle*PI/180.0);
+        tarX = tubes->rect[to].x+tubes->rect[to].width/2.0-tubes->rect[from].width*cos(tarAngle*PI/180.0);
+        tarY = tubes->rect[to].y-HEIGHT_POUR-tubes->rect[from].width*sin(tarAngle*PI/180.0);
         fullAngle = targetAngle[c1];
-        fullX = tubes[to].rect.x+tubes[to].rect.width/2.0-tubes[from].rect.width*cos(fullAngle*PI/180.0);
-        fullY = tubes[to].rect.y-HEIGHT_POUR-tubes[from].rect.width*sin(fullAngle*PI/180.0);
+        fullX = tubes->rect[to].x+tubes->rect[to].width/2.0-tubes->rect[from].width*cos(fullAngle*PI/180.0);
+        fullY = tubes->rect[to].y-HEIGHT_POUR-tubes->rect[from].width*sin(fullAngle*PI/180.0);
     } else {
         tarAngle = -targetAngle[c1-pourCnt];
-        tarX = tubes[to].rect.x+tubes[to].rect.width/2.0;
-        tarY = tubes[to].rect.y-HEIGHT_POUR;
+        tarX = tubes->rect[to].x+tubes->rect[to].width/2.0;
+        tarY = tubes->rect[to].y-HEIGHT_POUR;
         fullAngle = -targetAngle[c1];
-        fullX = tubes[to].rect.x+tubes[to].rect.width/2.0;
-        fullY = tubes[to].rect.y-HEIGHT_POUR;
+        fullX = tubes->rect[to].x+tubes->rect[to].width/2.0;
+        fullY = tubes->rect[to].y-HEIGHT_POUR;
     }
     // printf("Pouring Animation info:\n");
     // printf("from %d, to %d, pour count: %d, target angle: %f, full angle: %f\n", from, to, pourCnt, tarAngle, fullAngle);
@@ -549,9 +803,9 @@ void pour(Tube* tubes, int from, int to){
     
     // move animation to reach the top of target tube
     for(int i = 0; i < FRAME_MOVE; i++){
-        animationList[from][idx][RECT_X] = tubes[from].rect.x+i*(fullX-tubes[from].rect.x)/FRAME_MOVE;
-        animationList[from][idx][RECT_Y] = tubes[from].rect.y+i*(fullY-tubes[from].rect.y)/FRAME_MOVE;
-        animationList[from][idx][ANGLE] = tubes[from].angle+i*(fullAngle-tubes[from].angle)/FRAME_MOVE;
+        animationList[from][idx][RECT_X] = tubes->rect[from].x+i*(fullX-tubes->rect[from].x)/FRAME_MOVE;
+        animationList[from][idx][RECT_Y] = tubes->rect[from].y+i*(fullY-tubes->rect[from].y)/FRAME_MOVE;
+        animationList[from][idx][ANGLE] = tubes->angle[from]+i*(fullAngle-tubes->angle[from])/FRAME_MOVE;
         animationList[from][idx][ANIMATION_STAGE] = MOVE_TO;
         idx--;
     }
@@ -561,10 +815,10 @@ void pour(Tube* tubes, int from, int to){
         animationList[from][idx][ANGLE] = fullAngle+i*(tarAngle-fullAngle)/FRAME_POUR;
         animationList[from][idx][ANIMATION_STAGE] = POURING;
         if(pourRight){
-            float topRightX = animationList[from][idx+1][RECT_X]+tubes[from].rect.width*cos(animationList[from][idx+1][ANGLE]*PI/180.0),
-                  topRightY = animationList[from][idx+1][RECT_Y]+tubes[from].rect.width*sin(animationList[from][idx+1][ANGLE]*PI/180.0);
-            animationList[from][idx][RECT_X] = topRightX-tubes[from].rect.width*cos(animationList[from][idx][ANGLE]*PI/180.0);
-            animationList[from][idx][RECT_Y] = topRightY-tubes[from].rect.width*sin(animationList[from][idx][ANGLE]*PI/180.0);
+            float topRightX = animationList[from][idx+1][RECT_X]+tubes->rect[from].width*cos(animationList[from][idx+1][ANGLE]*PI/180.0),
+                  topRightY = animationList[from][idx+1][RECT_Y]+tubes->rect[from].width*sin(animationList[from][idx+1][ANGLE]*PI/180.0);
+            animationList[from][idx][RECT_X] = topRightX-tubes->rect[from].width*cos(animationList[from][idx][ANGLE]*PI/180.0);
+            animationList[from][idx][RECT_Y] = topRightY-tubes->rect[from].width*sin(animationList[from][idx][ANGLE]*PI/180.0);
         } else {
             animationList[from][idx][RECT_X] = animationList[from][idx+1][RECT_X];
             animationList[from][idx][RECT_Y] = animationList[from][idx+1][RECT_Y];
@@ -574,9 +828,9 @@ void pour(Tube* tubes, int from, int to){
 
     // move back animation
     for(int i = 0; i < FRAME_MOVE; i++){
-        animationList[from][idx][RECT_X] = tarX-i*(tarX-tubes[from].rect.x)/FRAME_MOVE;
-        animationList[from][idx][RECT_Y] = tarY-i*(tarY-tubes[from].rect.y)/FRAME_MOVE;
-        animationList[from][idx][ANGLE] = tarAngle-i*(tarAngle-tubes[from].angle)/FRAME_MOVE;
+        animationList[from][idx][RECT_X] = tarX-i*(tarX-tubes->rect[from].x)/FRAME_MOVE;
+        animationList[from][idx][RECT_Y] = tarY-i*(tarY-tubes->rect[from].y)/FRAME_MOVE;
+        animationList[from][idx][ANGLE] = tarAngle-i*(tarAngle-tubes->angle[from])/FRAME_MOVE;
         animationList[from][idx][ANIMATION_STAGE] = MOVE_BACK;
         if(i > 0) animationList[from][idx][POUR_COUNT] = 0; // when POURING stage done, POUR_COUNT is set to 0
         idx--;
@@ -586,8 +840,8 @@ void pour(Tube* tubes, int from, int to){
         exit(0);
     }
     
-    animationList[from][idx][RECT_X] = tubes[from].rect.x;
-    animationList[from][idx][RECT_Y] = tubes[from].rect.y+HEIGHT_SELECT;
+    animationList[from][idx][RECT_X] = tubes->rect[from].x;
+    animationList[from][idx][RECT_Y] = tubes->rect[from].y+HEIGHT_SELECT;
     animationList[from][idx][ANGLE] = 0.0;
     animationList[from][idx][ANIMATION_STAGE] = STILL;
     animationList[from][idx][POURING_TO] = -1;
@@ -598,48 +852,98 @@ void pour(Tube* tubes, int from, int to){
     //     printAnimationInfo(animationList[from][i], i);
     // }
     // exit(0);
+    return pourCnt;
+}
+
+void transferWater(Tubes* tubes, int i, int idx){
+    // update actual water amount when pouring stage complete
+    if(animationList[i][idx][ANIMATION_STAGE] == MOVE_BACK && animationList[i][idx+1][ANIMATION_STAGE] == POURING){
+        // printf("updating water count!\n");
+        // exit(0);
+        int to = animationList[i][idx][POURING_TO];
+        int c1 = countWater(tubes->contains[i]), c2 = countWater(tubes->contains[to]);
+        for(int j = 0; j < animationList[i][idx][POUR_COUNT]; j++){
+            tubes->contains[to][c2+j] = tubes->contains[i][c1-j-1];
+            tubes->contains[i][c1-j-1] = BLANK;
+        }
+    }
+}
+
+#ifdef WATERSORT_TRACE
+static const char* const STAGE_NAMES[] = {
+    "STILL", "SELECT_PRE", "SELECT_DONE", "SELECT_RECOVER", "MOVE_TO", "POURING", "MOVE_BACK"
+};
+#endif // WATERSORT_TRACE
+
+static void setStage(Tubes* tubes, int idx, int stage){
+    // every stage but STILL is one span on the tube's trace track
+    if(tubes->animationStage[idx] != stage){
+        if(tubes->animationStage[idx] != STILL) TRACE_TUBE_END(idx);
+        if(stage != STILL) TRACE_TUBE_BEGIN(STAGE_NAMES[stage], idx);
+    }
+    tubes->animationStage[idx] = stage;
 }
 
-void updateTubes(Tube* tubes){
+void updateTubes(Tubes* tubes){
     int idx;
     for(int i = 0; i < TUBE_NUM; i++){
         idx = animationIdx[i];
         if(idx == 0) continue;
         // printf("idx: %d, stage: %.0f, last stage: %.0f\n", idx, animationList[i][idx][ANIMATION_STAGE], animationList[i][1+idx][ANIMATION_STAGE]);
-
-        // update actual water amount when pouring stage complete
-        if(animationList[i][idx][ANIMATION_STAGE] == MOVE_BACK && animationList[i][idx+1][ANIMATION_STAGE] == POURING){
-            // printf("updating water count!\n");
-            // exit(0);
-            int to = animationList[i][idx][POURING_TO];
-            int c1 = countWater(tubes[i]), c2 = countWater(tubes[to]);
-            for(int j = 0; j < animationList[i][idx][POUR_COUNT]; j++){
-                tubes[to].contains[c2+j] = tubes[i].contains[c1-j-1];
-                tubes[i].contains[c1-j-1] = BLANK;
-            }
-        }
-        tubes[i].rect.x = animationList[i][idx][RECT_X];
-        tubes[i].rect.y = animationList[i][idx][RECT_Y];
-        tubes[i].angle = animationList[i][idx][ANGLE];
-        tubes[i].animationStage = animationList[i][idx][ANIMATION_STAGE];
+        transferWater(tubes, i, idx);
+        tubes->rect[i].x = animationList[i][idx][RECT_X];
+        tubes->rect[i].y = animationList[i][idx][RECT_Y];
+        tubes->angle[i] = animationList[i][idx][ANGLE];
+        setStage(tubes, i, animationList[i][idx][ANIMATION_STAGE]);
+        indexTube(tubes, i);
         // memset(animationList[i][idx], 0, sizeof(animationList[i][idx]));
         animationIdx[i]--;
     }
 }
 
-bool gameEnd(Tube* tubes){
+void advanceTubes(Tubes* tubes, int frameNum){
+    // same as frameNum calls of updateTubes, but each tube only lands on its last frame.
+    // water still moves frame by frame: two pours into one empty tube land in the order they finish
+    int frames = 0;
+    for(int i = 0; i < TUBE_NUM; i++) frames = max(frames, min(animationIdx[i], frameNum));
+    for(int f = 0; f < frames; f++)
+        for(int i = 0; i < TUBE_NUM; i++)
+            if(animationIdx[i]-f >= 1) transferWater(tubes, i, animationIdx[i]-f);
+    for(int i = 0; i < TUBE_NUM; i++){
+        int idx = animationIdx[i];
+        if(idx == 0) continue;
+        int end = max(idx-frameNum+1, 1);
+        tubes->rect[i].x = animationList[i][end][RECT_X];
+        tubes->rect[i].y = animationList[i][end][RECT_Y];
+        tubes->angle[i] = animationList[i][end][ANGLE];
+        setStage(tubes, i, animationList[i][end][ANIMATION_STAGE]);
+        indexTube(tubes, i);
+        animationIdx[i] = end-1;
+    }
+}
+
+void settleTubes(Tubes* tubes){
+    // play every animation to its end at once: pending pours land, the selected tube goes down
+    if(selectedTube != -1){
+        deselectTube(tubes, selectedTube);
+        selectedTube = -1;
+    }
+    advanceTubes(tubes, MAX_FRAME_NUM);
+}
+
+bool gameEnd(Tubes* tubes){
     for(int i = 0; i < TUBE_NUM; i++)
         if(animationIdx[i] > 0) return false; // finish all the animation
     for(int i = 0; i < TUBE_NUM; i++){
-        if(countWater(tubes[i]) == MAX_TUBE_WATER){
-            for(int j = 1; j < MAX_TUBE_WATER; j++)
-                if(!sameColor(tubes[i].contains[j], tubes[i].contains[j-1])) return false;
-        } else if(countWater(tubes[i]) != 0) return false;
+        if(countWater(tubes->contains[i]) == TUBE_CAPACITY){
+            for(int j = 1; j < TUBE_CAPACITY; j++)
+                if(!sameColor(tubes->contains[i][j], tubes->contains[i][j-1])) return false;
+        } else if(countWater(tubes->contains[i]) != 0) return false;
     }
     return true;
 }
 
-bool pouredTo(Tube* tubes, int idx){
+bool pouredTo(Tubes* tubes, int idx){
     for(int i = 0; i < TUBE_NUM; i++){
         if(i == idx) continue;
         for(int j = 1; j <= animationIdx[i]; j++)
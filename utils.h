@@ -1,15 +1,26 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include "grid.h"
+#include "geometry.h"
+
 #define PI 3.14159265358979323846
 #define max(a, b) ((a) > (b) ? (a) : (b))
 #define min(a, b) ((a) < (b) ? (a) : (b))
 
-#define MAX_TUBE_WATER      4
-#define MAX_TUBE_NUM        20
+#define MIN_TUBE_WATER      3   // tube capacity range of a level
+#define MAX_TUBE_WATER      12
 #define MAX_FRAME_NUM       240
 #define ANIMATION_INFO_LENGTH 6
+#define WALL_RING_SEGMENTS  32  // most segments of the half ring at a tube bottom
+#define WALL_VERTEX_NUM     (12+6*WALL_RING_SEGMENTS) // triangle vertices of one tube wall
 #define TUBE_WALL_COLOR     DARKBROWN
+#define DETAIL_STILL_SAMPLES    24      // water samples across a still tube
+#define DETAIL_MOVING_SAMPLES   64      // across a moving tube
+#define DETAIL_FRAME_SAMPLES    20000   // over all tubes in a frame
+#define WAVE_AMPLITUDE      2.0     // pixels
+#define WAVE_FREQUENCY      150.0   // radians across the screen width
+#define WAVE_SPEED          0.1     // radians per frame
 #define BACKGROUND_COLOR    DARKGRAY
 
 // game related global variables
@@ -20,6 +31,7 @@ extern int screenHeight;
 // tube related global variables
 extern int selectedTube;
 extern int TUBE_NUM;
+extern int TUBE_CAPACITY;
 extern int TUBE_THICKNESS;
 extern float TUBE_WIDTH;
 extern float TUBE_HEIGHT;
@@ -32,15 +44,22 @@ extern float HEIGHT_POUR;
 extern int FRAME_SELECT; // # of frames for pulling up a tube
 extern int FRAME_MOVE;
 extern int FRAME_POUR; // # of frames for pouring water
-extern float animationList[MAX_TUBE_NUM][MAX_FRAME_NUM][ANIMATION_INFO_LENGTH];
-extern int animationIdx[MAX_TUBE_NUM];
+extern float (*animationList)[MAX_FRAME_NUM][ANIMATION_INFO_LENGTH];
+extern int* animationIdx;
 
-typedef struct Tube {
-    Rectangle rect;
-    Color contains[MAX_TUBE_WATER];
-    float angle;
-    int animationStage;
-}Tube;
+// TUBE_NUM tubes, one array per field: rules only read contains,
+// drawing and hit testing read rect and angle
+typedef struct Tubes {
+    Color (*contains)[MAX_TUBE_WATER];  // water colors, bottom to top
+    Rectangle* rect;
+    float* angle;
+    int* animationStage;
+    TubeGrid* grid;                     // hit testing index over rect and angle
+    Vector2 (*wall)[WALL_VERTEX_NUM];   // wall triangles, built from rect and angle when drawn
+    int* wallVertexNum;                 // 0 when rect or angle changed since
+    Geometry* water;                    // water triangles, rebuilt every frame
+    float* detail;                      // water sample spacing in pixels, see chooseDetail
+}Tubes;
 
 typedef enum {
     STILL           = 0,
@@ -63,29 +82,43 @@ typedef enum {
 
 bool sameColor(Color x, Color y);
 bool emptyColor(Color c);
-int countWater(Tube tube);
-bool insideTube(Vector2 pos, Tube tube);
+int countWater(const Color* contains);
+void setTubeCapacity(int capacity);
+bool insideTube(Vector2 pos, Rectangle rect, float angle);
+Rectangle tubeBounds(Rectangle rect, float angle);
 void copyAnimation(float* dst, float src[ANIMATION_INFO_LENGTH]);
 
 int isPourLeft(float angle);
 float waterLevelAnimation(float pourProcessRatio, int waterTotal);
-float getPouredAmount(Tube* tubes, int idx);
+float getPouredAmount(Tubes* tubes, int idx);
 
-void printTubeInfo(Tube tube, int idx);
+void printTubeInfo(Tubes* tubes, int idx);
 void printAnimationInfo(float info[ANIMATION_INFO_LENGTH], int idx);
-void initTube(Tube* tube, Rectangle rect, float angle, Color tubeColors[MAX_TUBE_WATER]);
-void initTubes(Tube* tubes);
-void initGame(Tube* tubes);
+Tubes* newTubes(int tubeNum);
+void freeTubes(Tubes* tubes);
+void initTube(Tubes* tubes, int idx, Rectangle rect, float angle, const Color* tubeColors);
+void initTubes(Tubes* tubes);
+void initAnimations(void);
+void initGame(Tubes* tubes);
+void indexTube(Tubes* tubes, int idx);
+void indexTubes(Tubes* tubes, float width, float height);
+int tubeAt(Tubes* tubes, Vector2 pos);
 
-void drawWater(Tube* tubes, int idx);
-void drawTubes(Tube* tubes);
+void updateWaveTable(void);
+void chooseDetail(Tubes* tubes);
+void buildWater(Tubes* tubes, int idx);
+int tubeWall(Tubes* tubes, int idx);
+void drawTubes(Tubes* tubes);
 
-bool pouredTo(Tube* tubes, int idx);
-bool gameEnd(Tube* tubes);
-void selectTube(Tube* tubes, int tubeIdx);
-void deselectTube(Tube* tubes, int tubeIdx);
-bool checkPour(Tube* tubes, int from, int to);
-void pour(Tube* tubes, int from, int to);
-void updateTubes(Tube* tubes);
+bool pouredTo(Tubes* tubes, int idx);
+bool gameEnd(Tubes* tubes);
+void selectTube(Tubes* tubes, int tubeIdx);
+void deselectTube(Tubes* tubes, int tubeIdx);
+bool checkPour(Tubes* tubes, int from, int to);
+int pour(Tubes* tubes, int from, int to);
+void transferWater(Tubes* tubes, int i, int idx);
+void updateTubes(Tubes* tubes);
+void advanceTubes(Tubes* tubes, int frameNum);
+void settleTubes(Tubes* tubes);
 
 #endif // UTILS_H
\ No newline at end of file
@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "raylib.h"
+#include "utils.h"
+#include "solver.h"
+
+#define VERIFY_BATCH        16384   // submissions read and verified at a time
+#define VERIFY_MAX_MOVES    4096
+#define VERDICT_LENGTH      96
+
+// verifies leaderboard submissions, one per line:
+//   <id> <level> <from>-<to> <from>-<to> ...
+// <level> is an index into the levels file (one level text per line, see boardParse)
+// or an inline level text; index 0 is the built-in level when no levels file is given.
+// prints "<id> OK <# of pours>", "<id> ILLEGAL <index of the first illegal pour>",
+// "<id> UNSOLVED" or "<id> BAD_INPUT" per line, in input order.
+//   ./verify [-l levels.txt] [submissions.txt]   (stdin when no file is given)
+
+typedef struct Level {
+    Board board;
+    unsigned char* state;
+} Level;
+
+typedef struct VerifyJob {
+    char** lines;
+    char (*verdicts)[VERDICT_LENGTH];
+    int lineNum;
+    int next;               // next line to verify, shared by all workers
+    const Level* levels;
+    int levelNum;
+    int stateSize;          // largest board of the levels file
+} VerifyJob;
+
+double verifyTime(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec+ts.tv_nsec*1e-9;
+}
+
+void verifyLine(const VerifyJob* job, const char* line, char* verdict, Move* moves, unsigned char* state){
+    char id[64];
+    int idLength = 0;
+    const char* p = line;
+    while(*p == ' ') p++;
+    while(*p && *p != ' ' && *p != '\n' && *p != '\r' && idLength < 63) id[idLength++] = *p++;
+    id[idLength] = 0;
+    while(*p == ' ') p++;
+
+    // level
+    const Level* level = NULL;
+    Level inline_;
+    const char* token = p;
+    while(*p && *p != ' ' && *p != '\n' && *p != '\r') p++;
+    if(memchr(token, ':', p-token)){
+        inline_.state = boardParse(&inline_.board, token);
+        if(inline_.state) level = &inline_;
+    } else if(p > token){
+        char* end;
+        long idx = strtol(token, &end, 10);
+        if(end == p && idx >= 0 && idx < job->levelNum) level = &job->levels[idx];
+    }
+    if(!level || idLength == 0){
+        snprintf(verdict, VERDICT_LENGTH, "%s BAD_INPUT\n", id);
+        return;
+    }
+
+    // pours
+    int moveNum = 0;
+    bool bad = false;
+    while(!bad){
+        while(*p == ' ') p++;
+        if(*p == 0 || *p == '\n' || *p == '\r') break;
+        char* end;
+        long from = strtol(p, &end, 10);
+        if(end == p || *end != '-' || moveNum == VERIFY_MAX_MOVES){
+            bad = true;
+            break;
+        }
+        p = end+1;
+        long to = strtol(p, &end, 10);
+        // checked as long: a tube past INT_MAX must not wrap around to a real one
+        if(end == p || from < 0 || from >= level->board.tubeNum || to < 0 || to >= level->board.tubeNum){
+            bad = true;
+            break;
+        }
+        p = end;
+        moves[moveNum++] = (Move){ (int)from, (int)to, 0 };
+    }
+
+    if(bad){
+        snprintf(verdict, VERDICT_LENGTH, "%s BAD_INPUT\n", id);
+    } else {
+        // inline levels are parsed per line and replayed in place
+        if(level == &inline_) state = inline_.state;
+        else memcpy(state, level->state, boardSize(&level->board));
+        int done = boardReplay(&level->board, state, moves, moveNum);
+        if(done < moveNum) snprintf(verdict, VERDICT_LENGTH, "%s ILLEGAL %d\n", id, done);
+        else if(!boardSolved(&level->board, state)) snprintf(verdict, VERDICT_LENGTH, "%s UNSOLVED\n", id);
+        else snprintf(verdict, VERDICT_LENGTH, "%s OK %d\n", id, moveNum);
+    }
+    if(level == &inline_) free(inline_.state);
+}
+
+void* verifyWorker(void* arg){
+    VerifyJob* job = arg;
+    Move* moves = malloc(sizeof(Move)*VERIFY_MAX_MOVES);
+    unsigned char* state = malloc(job->stateSize);
+    int idx;
+    while((idx = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->lineNum)
+        verifyLine(job, job->lines[idx], job->verdicts[idx], moves, state);
+    free(state);
+    free(moves);
+    return NULL;
+}
+
+Level* loadLevels(const char* path, int* levelNum){
+    Level* levels = NULL;
+    *levelNum = 0;
+    if(!path){
+        levels = malloc(sizeof(Level));
+        Tubes* tubes = newTubes(TUBE_NUM);
+        initTubes(tubes);
+        levels[0].state = boardFromTubes(&levels[0].board, tubes);
+        freeTubes(tubes);
+        *levelNum = 1;
+        return levels;
+    }
+    FILE* file = fopen(path, "r");
+    if(!file) return NULL;
+    char* line = NULL;
+    size_t cap = 0;
+    while(getline(&line, &cap, file) > 0){
+        levels = realloc(levels, sizeof(Level)*(*levelNum+1));
+        levels[*levelNum].state = boardParse(&levels[*levelNum].board, line);
+        if(!levels[*levelNum].state){
+            printf("Error: bad level %d in %s\n", *levelNum, path);
+            exit(-1);
+        }
+        (*levelNum)++;
+    }
+    free(line);
+    fclose(file);
+    return levels;
+}
+
+int main(int argc, char** argv){
+    const char* levelPath = NULL;
+    const char* inputPath = NULL;
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "-l") == 0 && i+1 < argc) levelPath = argv[++i];
+        else inputPath = argv[i];
+    }
+    int levelNum;
+    Level* levels = loadLevels(levelPath, &levelNum);
+    FILE* input = inputPath ? fopen(inputPath, "r") : stdin;
+    if(!levels || !input){
+        printf("Error: cannot open %s\n", levels ? inputPath : levelPath);
+        return -1;
+    }
+
+    int stateSize = 1;
+    for(int i = 0; i < levelNum; i++) stateSize = max(stateSize, boardSize(&levels[i].board));
+    char** lines = calloc(VERIFY_BATCH, sizeof(char*));
+    size_t* caps = calloc(VERIFY_BATCH, sizeof(size_t));
+    char (*verdicts)[VERDICT_LENGTH] = malloc(VERIFY_BATCH*VERDICT_LENGTH);
+    int threadNum = solverThreadNum();
+    pthread_t* threads = malloc(sizeof(pthread_t)*threadNum);
+    long long total = 0;
+    double begin = verifyTime();
+    while(1){
+        int lineNum = 0;
+        while(lineNum < VERIFY_BATCH && getline(&lines[lineNum], &caps[lineNum], input) > 0)
+            if(lines[lineNum][0] != '\n') lineNum++;
+        if(lineNum == 0) break;
+        VerifyJob job = { lines, verdicts, lineNum, 0, levels, levelNum, stateSize };
+        for(int t = 1; t < threadNum; t++) pthread_create(&threads[t], NULL, verifyWorker, &job);
+        verifyWorker(&job);
+        for(int t = 1; t < threadNum; t++) pthread_join(threads[t], NULL);
+        for(int i = 0; i < lineNum; i++) fputs(verdicts[i], stdout);
+        total += lineNum;
+        if(lineNum < VERIFY_BATCH) break;
+    }
+    double elapsed = verifyTime()-begin;
+    fprintf(stderr, "Verified %lld submissions in %.3f s (%.0f/min, %d threads)\n",
+            total, elapsed, total*60.0/max(elapsed, 1e-9), threadNum);
+
+    for(int i = 0; i < VERIFY_BATCH; i++) free(lines[i]);
+    for(int i = 0; i < levelNum; i++) free(levels[i].state);
+    free(threads);
+    free(verdicts);
+    free(caps);
+    free(lines);
+    free(levels);
+    if(input != stdin) fclose(input);
+    return 0;
+}
@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "visited.h"
+
+static uint32_t fingerprint(uint64_t hash){
+    // the high half, the bucket comes from the low one. 0 marks empty slots
+    uint32_t fp = hash >> 32;
+    return fp ? fp : 1;
+}
+
+static size_t altBucket(const VisitedSet* set, size_t bucket, uint32_t fp){
+    // the other bucket of a fingerprint, from either of the two
+    uint64_t h = fp*0xC2B2AE3D27D4EB4FULL;
+    return (bucket ^ (h ^ h >> 29)) & set->mask;
+}
+
+static bool bucketHas(const VisitedSet* set, size_t bucket, uint32_t fp){
+    for(int i = 0; i < VISITED_BUCKET_SIZE; i++)
+        if(set->buckets[bucket][i] == fp) return true;
+    return false;
+}
+
+static bool bucketPut(VisitedSet* set, size_t bucket, uint32_t fp){
+    for(int i = 0; i < VISITED_BUCKET_SIZE; i++)
+        if(set->buckets[bucket][i] == 0){
+            set->buckets[bucket][i] = fp;
+            return true;
+        }
+    return false;
+}
+
+static size_t overflowSlot(const VisitedSet* set, size_t bucket){
+    uint64_t h = bucket*0x9E3779B97F4A7C15ULL;
+    return (h ^ h >> 32) & set->overflowMask;
+}
+
+static bool overflowHas(const VisitedSet* set, size_t bucket, uint32_t fp){
+    if(!set->overflow) return false;
+    for(size_t i = overflowSlot(set, bucket); set->overflow[i].fingerprint; i = (i+1) & set->overflowMask)
+        if(set->overflow[i].fingerprint == fp && set->overflow[i].bucket == bucket) return true;
+    return false;
+}
+
+static void overflowPut(VisitedSet* set, size_t bucket, uint32_t fp){
+    // grown at half load
+    if((set->overflowNum+1)*2 > (set->overflow ? set->overflowMask+1 : 0)){
+        VisitedOverflow* old = set->overflow;
+        size_t oldCap = old ? set->overflowMask+1 : 0, cap = oldCap ? oldCap*2 : 64;
+        set->overflow = calloc(cap, sizeof(VisitedOverflow));
+        set->overflowMask = cap-1;
+        for(size_t i = 0; i < oldCap; i++){
+            if(!old[i].fingerprint) continue;
+            size_t j = overflowSlot(set, old[i].bucket);
+            while(set->overflow[j].fingerprint) j = (j+1) & set->overflowMask;
+            set->overflow[j] = old[i];
+        }
+        free(old);
+    }
+    size_t i = overflowSlot(set, bucket);
+    while(set->overflow[i].fingerprint) i = (i+1) & set->overflowMask;
+    set->overflow[i] = (VisitedOverflow){ fp, bucket };
+    set->overflowNum++;
+}
+
+static bool fingerprintSeen(const VisitedSet* set, size_t b1, size_t b2, uint32_t fp){
+    return bucketHas(set, b1, fp) || bucketHas(set, b2, fp) || overflowHas(set, b1, fp) || overflowHas(set, b2, fp);
+}
+
+static bool fingerprintInsert(VisitedSet* set, uint64_t hash){
+    uint32_t fp = fingerprint(hash);
+    size_t b1 = hash & set->mask, b2 = altBucket(set, b1, fp);
+    if(fingerprintSeen(set, b1, b2, fp)) return false;
+    set->num++;
+    if(bucketPut(set, b1, fp) || bucketPut(set, b2, fp)) return true;
+    // both buckets full: move a random fingerprint to its other bucket until one has room
+    size_t bucket = set->rng & 1 ? b1 : b2;
+    for(int k = 0; k < VISITED_MAX_KICKS; k++){
+        set->rng ^= set->rng << 13;
+        set->rng ^= set->rng >> 7;
+        set->rng ^= set->rng << 17;
+        int slot = set->rng % VISITED_BUCKET_SIZE;
+        uint32_t victim = set->buckets[bucket][slot];
+        set->buckets[bucket][slot] = fp;
+        fp = victim;
+        bucket = altBucket(set, bucket, fp);
+        if(bucketPut(set, bucket, fp)) return true;
+    }
+    // the table is past its load, the homeless fingerprint is kept aside. a full
+    // table keeps kicking VISITED_MAX_KICKS times per insert, so the overflow is capped
+    size_t slotNum = (set->mask+1)*VISITED_BUCKET_SIZE, overflowMax = slotNum/VISITED_OVERFLOW_SHARE;
+    if(set->overflowNum >= (overflowMax > VISITED_OVERFLOW_MIN ? overflowMax : VISITED_OVERFLOW_MIN)){
+        printf("Error: visited set of %zu slots is full at %zu boards, raise the expected count\n", slotNum, set->num);
+        exit(-1);
+    }
+    overflowPut(set, bucket, fp);
+    return true;
+}
+
+static bool exactInsert(VisitedSet* set, uint64_t hash){
+    // plain open addressing over full hashes, grown at half load
+    if((set->lookups+1)*2 > (long long)set->exactMask+1){
+        uint64_t* old = set->exact;
+        size_t oldCap = set->exactMask+1;
+        set->exactMask = oldCap*2-1;
+        set->exact = calloc(oldCap*2, sizeof(uint64_t));
+        for(size_t i = 0; i < oldCap; i++){
+            if(!old[i]) continue;
+            size_t j = old[i] & set->exactMask;
+            while(set->exact[j]) j = (j+1) & set->exactMask;
+            set->exact[j] = old[i];
+        }
+        free(old);
+    }
+    hash = hash ? hash : 1;
+    size_t i = hash & set->exactMask;
+    for(; set->exact[i]; i = (i+1) & set->exactMask)
+        if(set->exact[i] == hash) return false;
+    set->exact[i] = hash;
+    return true;
+}
+
+void visitedInit(VisitedSet* set, size_t expected, bool verify){
+    memset(set, 0, sizeof(VisitedSet));
+    size_t bucketNum = 1;
+    while(bucketNum*VISITED_BUCKET_SIZE*VISITED_MAX_LOAD < expected) bucketNum <<= 1;
+    set->mask = bucketNum-1;
+    set->bytes = bucketNum*sizeof(set->buckets[0]);
+    // zero pages straight from the kernel, in huge pages where it allows them
+    void* buckets = mmap(NULL, set->bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(buckets == MAP_FAILED){
+        printf("Error: cannot map %zu bytes for a visited set\n", set->bytes);
+        exit(-1);
+    }
+    set->buckets = buckets;
+#ifdef MADV_HUGEPAGE
+    if(set->bytes >= VISITED_HUGE_PAGE) set->hugePages = madvise(buckets, set->bytes, MADV_HUGEPAGE) == 0;
+#endif
+    set->rng = 0x9E3779B97F4A7C15ULL;
+    set->verify = verify;
+    if(verify){
+        set->exactMask = 15;
+        set->exact = calloc(16, sizeof(uint64_t));
+    }
+}
+
+void visitedFree(VisitedSet* set){
+    munmap(set->buckets, set->bytes);
+    free(set->overflow);
+    free(set->exact);
+    set->buckets = NULL;
+    set->overflow = NULL;
+    set->exact = NULL;
+}
+
+bool visitedContains(const VisitedSet* set, uint64_t hash){
+    // safe from several threads as long as nobody inserts
+    uint32_t fp = fingerprint(hash);
+    size_t b1 = hash & set->mask;
+    return fingerprintSeen(set, b1, altBucket(set, b1, fp), fp);
+}
+
+bool visitedInsert(VisitedSet* set, uint64_t hash){
+    // false if the hash was (or looks) visited already. with verify the answer is
+    // the exact one, and new hashes the fingerprints take for visited are counted
+    if(!set->verify) return fingerprintInsert(set, hash);
+    bool added = fingerprintInsert(set, hash);
+    if(!exactInsert(set, hash)) return false;
+    set->lookups++;
+    if(!added) set->falsePositives++;
+    return true;
+}
+
+double visitedLoad(const VisitedSet* set){
+    return (double)(set->num-set->overflowNum)/((set->mask+1)*VISITED_BUCKET_SIZE);
+}
+
+double visitedExpectedRate(const VisitedSet* set){
+    // chance that one of the fingerprints in the two buckets of a new hash matches it
+    return 2.0*VISITED_BUCKET_SIZE*visitedLoad(set)/4294967296.0;
+}
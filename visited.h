@@ -0,0 +1,52 @@
+#ifndef VISITED_H
+#define VISITED_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define VISITED_BUCKET_SIZE     4       // fingerprints per bucket, 16 bytes
+#define VISITED_MAX_LOAD        0.95    // buckets are sized for the expected # of states at this load
+#define VISITED_MAX_KICKS       512     // fingerprints moved by one insert before it goes to the overflow
+#define VISITED_OVERFLOW_SHARE  64      // the overflow holds at most 1/64 of the slots...
+#define VISITED_OVERFLOW_MIN    1024    // ...or this many fingerprints in small sets
+#define VISITED_HUGE_PAGE       (1 << 21)
+
+// a fingerprint that found no slot, with the bucket it was kicked from. 0 marks empty slots
+typedef struct VisitedOverflow {
+    uint32_t fingerprint;
+    size_t bucket;
+} VisitedOverflow;
+
+// visited boards as 32 bit fingerprints of their canonical hash in a cuckoo table:
+// each hash has two buckets, a lookup reads two cache lines at most. about 4.2 bytes
+// a board at full load, a billion boards fit in 4 GB. a board never seen may be taken
+// for a visited one (a false positive, about 2e-9 per lookup), a visited one is never missed.
+// with verify, every hash is also kept exactly and false positives are counted.
+// `expected` of visitedInit is a hard limit: past it inserts fill the overflow and
+// the process stops with an error once the overflow outgrows its share
+typedef struct VisitedSet {
+    uint32_t (*buckets)[VISITED_BUCKET_SIZE];  // 0 for an empty slot
+    size_t mask;                // # of buckets-1
+    size_t bytes;               // of the bucket mapping
+    size_t num;
+    bool hugePages;             // the kernel took the huge page advice
+    uint64_t rng;               // picks the fingerprint to kick
+    VisitedOverflow* overflow;  // hashed by bucket, linear probing
+    size_t overflowMask;
+    size_t overflowNum;
+    bool verify;
+    uint64_t* exact;            // every inserted hash, 0 for an empty slot
+    size_t exactMask;
+    long long lookups;          // inserts of new hashes, counted with verify
+    long long falsePositives;   // of those, rejected as visited
+} VisitedSet;
+
+void visitedInit(VisitedSet* set, size_t expected, bool verify);
+void visitedFree(VisitedSet* set);
+bool visitedContains(const VisitedSet* set, uint64_t hash);
+bool visitedInsert(VisitedSet* set, uint64_t hash);
+double visitedLoad(const VisitedSet* set);
+double visitedExpectedRate(const VisitedSet* set);
+
+#endif // VISITED_H